@@ -1,4 +1,6 @@
+#include <array>
 #include <functional>
+#include <memory>
 #include <benchmark/benchmark.h>
 #include <ccl2/function.h>
 
@@ -7,7 +9,9 @@ static void BM_std_function(benchmark::State& state) {
         std::function<int(int, int)> f = [](int a, int b) {
             return a + b;
         };
-        [[maybe_unused]] auto r = f(3, 4);
+        benchmark::DoNotOptimize(f);
+        auto r = f(3, 4);
+        benchmark::DoNotOptimize(r);
     }
 }
 
@@ -15,9 +19,91 @@ BENCHMARK(BM_std_function);
 
 static void BM_ccl2_function(benchmark::State& state) {
     for (auto _ : state) {
-        ccl2::function<int> f   = ccl2::bind([](int a, int b) { return a + b; });
-        [[maybe_unused]] auto r = ccl2::invoke(f, 3, 4);
+        ccl2::function<int> f = ccl2::bind([](int a, int b) { return a + b; });
+        benchmark::DoNotOptimize(f);
+        auto r = ccl2::invoke(f, 3, 4);
+        benchmark::DoNotOptimize(r);
     }
 }
 
 BENCHMARK(BM_ccl2_function);
+
+// 32 bytes of state, beyond the local buffer of std::function
+static void BM_std_function_capture(benchmark::State& state) {
+    std::array<int64_t, 4> c{1, 2, 3, 4};
+    for (auto _ : state) {
+        std::function<int(int, int)> f = [c](int a, int b) {
+            return int(a + b + c[0] + c[3]);
+        };
+        benchmark::DoNotOptimize(f);
+        auto r = f(3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_std_function_capture);
+
+static void BM_ccl2_function_capture(benchmark::State& state) {
+    std::array<int64_t, 4> c{1, 2, 3, 4};
+    for (auto _ : state) {
+        ccl2::function<int> f = ccl2::bind([c](int a, int b) {
+            return int(a + b + c[0] + c[3]);
+        });
+        benchmark::DoNotOptimize(f);
+        auto r = ccl2::invoke(f, 3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_ccl2_function_capture);
+
+// std::function needs a copyable callable, wrap it into a shared_ptr
+static void BM_std_function_move_only(benchmark::State& state) {
+    for (auto _ : state) {
+        auto p = std::make_shared<std::unique_ptr<int>>(std::make_unique<int>(1));
+        std::function<int(int, int)> f = [p](int a, int b) {
+            return a + b + **p;
+        };
+        benchmark::DoNotOptimize(f);
+        auto r = f(3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_std_function_move_only);
+
+static void BM_ccl2_function_move_only(benchmark::State& state) {
+    for (auto _ : state) {
+        ccl2::function<int> f =
+            ccl2::bind([p = std::make_unique<int>(1)](int a, int b) { return a + b + *p; });
+        benchmark::DoNotOptimize(f);
+        auto r = ccl2::invoke(f, 3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_ccl2_function_move_only);
+
+static void BM_std_function_call(benchmark::State& state) {
+    std::function<int(int, int)> f = [](int a, int b) {
+        return a + b;
+    };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(f);
+        auto r = f(3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_std_function_call);
+
+static void BM_ccl2_function_call(benchmark::State& state) {
+    ccl2::function<int> f = ccl2::bind([](int a, int b) { return a + b; });
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(f);
+        auto r = ccl2::invoke(f, 3, 4);
+        benchmark::DoNotOptimize(r);
+    }
+}
+
+BENCHMARK(BM_ccl2_function_call);
@@ -0,0 +1,28 @@
+#include <memory>
+#include <benchmark/benchmark.h>
+#include <ccl2/ring_buffer.h>
+
+// push + pop with `backlog` items queued ahead, on a ring of 1024. Beyond the ring
+// the items spill, and every push and pop goes through the overflow mutex until the
+// backlog is drained.
+static void BM_spill_queue(benchmark::State& state) {
+    static std::unique_ptr<ccl2::detail::spill_queue<int>> q;
+    if (state.thread_index() == 0) {
+        q = std::make_unique<ccl2::detail::spill_queue<int>>(1024);
+        for (int64_t i = 0; i < state.range(0); i++) {
+            q->push(int(i));
+        }
+    }
+
+    for (auto _ : state) {
+        q->push(1);
+        auto v = q->try_pop();
+        benchmark::DoNotOptimize(v);
+    }
+
+    if (state.thread_index() == 0) {
+        q.reset();
+    }
+}
+
+BENCHMARK(BM_spill_queue)->Arg(0)->Arg(4096)->Threads(1)->Threads(4)->UseRealTime();
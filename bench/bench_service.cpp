@@ -0,0 +1,106 @@
+#include <shared_mutex>
+#include <string>
+#include <ccl2/service.h>
+#include <benchmark/benchmark.h>
+
+namespace {
+
+const ccl2::Topic<int(int, int)> kAdd{"/algorithm/add/17"};
+
+// a few dozen services
+template <class Svc>
+Svc& make_service() {
+    static Svc svc;
+    static bool init = [] {
+        for (int i = 0; i < 32; i++) {
+            svc.register_handler("/algorithm/add/" + std::to_string(i),
+                                 [](int a, int b) { return a + b; });
+        }
+        return true;
+    }();
+    (void)init;
+    return svc;
+}
+
+using SharedMutexService = ccl2::Service<std::shared_mutex, std::shared_lock>;
+using RcuService         = ccl2::Service<ccl2::RcuMutex, std::shared_lock>;
+
+}  // namespace
+
+static void BM_service_call_name(benchmark::State& state) {
+    auto& svc = make_service<ccl2::Service<>>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.call<int>("/algorithm/add/17", 1, 2));
+    }
+}
+
+BENCHMARK(BM_service_call_name);
+
+static void BM_service_call_topic(benchmark::State& state) {
+    auto& svc = make_service<ccl2::Service<>>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.call(kAdd, 1, 2));
+    }
+}
+
+BENCHMARK(BM_service_call_topic);
+
+static void BM_service_call_handle(benchmark::State& state) {
+    auto add = make_service<ccl2::Service<>>().resolve(kAdd);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(add(1, 2));
+    }
+}
+
+BENCHMARK(BM_service_call_handle);
+
+// a shared lock bounces its cache line between the calling cores
+template <class Svc>
+static void BM_service_call_concurrent(benchmark::State& state) {
+    auto& svc = make_service<Svc>();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.call(kAdd, 1, 2));
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_service_call_concurrent, SharedMutexService)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_service_call_concurrent, RcuService)->ThreadRange(1, 8);
+
+// a lookup worth caching, against its cached result
+static int slow_lookup(int key) {
+    int r = key;
+    for (int i = 0; i < 1000; i++) {
+        benchmark::DoNotOptimize(r = r * 31 + i);
+    }
+    return r;
+}
+
+static void BM_service_call_lookup(benchmark::State& state) {
+    static const ccl2::Topic<int(int)> kLookup{"/lookup"};
+    static ccl2::Service<> svc;
+    static bool init = [] {
+        svc.register_handler(kLookup, slow_lookup);
+        return true;
+    }();
+    (void)init;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.call(kLookup, 17));
+    }
+}
+
+BENCHMARK(BM_service_call_lookup);
+
+static void BM_service_call_memoized(benchmark::State& state) {
+    static const ccl2::Topic<int(int)> kLookup{"/lookup"};
+    static ccl2::Service<> svc;
+    static bool init = [] {
+        svc.register_handler(kLookup, slow_lookup, ccl2::MemoizeOptions{});
+        return true;
+    }();
+    (void)init;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(svc.call(kLookup, 17));
+    }
+}
+
+BENCHMARK(BM_service_call_memoized)->ThreadRange(1, 8);
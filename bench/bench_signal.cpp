@@ -0,0 +1,173 @@
+#include <shared_mutex>
+#include <string>
+#include <ccl2/signal.h>
+#include <ccl2/signal_batch.h>
+#include <ccl2/signal_subscriber.h>
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// a telemetry bus, a few dozen topics
+ccl2::Signal<>& make_signal() {
+    static ccl2::Signal<> sig;
+    static bool init = [] {
+        for (int i = 0; i < 32; i++) {
+            sig.register_handler("/telemetry/sensor/" + std::to_string(i),
+                                 [](int v, double x) {
+                                     benchmark::DoNotOptimize(v + x);
+                                 });
+        }
+        return true;
+    }();
+    (void)init;
+    return sig;
+}
+
+}  // namespace
+
+static void BM_signal_emit_name(benchmark::State& state) {
+    auto& sig = make_signal();
+    for (auto _ : state) {
+        sig.emit("/telemetry/sensor/17", 1, 2.0);
+    }
+}
+
+BENCHMARK(BM_signal_emit_name);
+
+static void BM_signal_emit_topic(benchmark::State& state) {
+    auto& sig = make_signal();
+    const ccl2::Topic<void(int, double)> topic{"/telemetry/sensor/17"};
+    for (auto _ : state) {
+        sig.emit(topic, 1, 2.0);
+    }
+}
+
+BENCHMARK(BM_signal_emit_topic);
+
+static void BM_signal_emit_handle(benchmark::State& state) {
+    auto& sig = make_signal();
+    auto h    = sig.resolve(ccl2::Topic<void(int, double)>{"/telemetry/sensor/17"});
+    for (auto _ : state) {
+        sig.emit(h, 1, 2.0);
+    }
+}
+
+BENCHMARK(BM_signal_emit_handle);
+
+// one pattern instead of 32 exact topics, matched once per topic then cached
+static void BM_signal_emit_wildcard(benchmark::State& state) {
+    static ccl2::Signal<> sig;
+    static bool init = [] {
+        sig.register_handler("/telemetry/sensor/*",
+                             [](int v, double x) { benchmark::DoNotOptimize(v + x); });
+        return true;
+    }();
+    (void)init;
+    for (auto _ : state) {
+        sig.emit("/telemetry/sensor/17", 1, 2.0);
+    }
+}
+
+BENCHMARK(BM_signal_emit_wildcard);
+
+// a shared lock bounces its cache line between the emitting cores
+template <class Sig>
+static void BM_signal_emit_concurrent(benchmark::State& state) {
+    static Sig sig;
+    static auto h = [] {
+        sig.register_handler("/telemetry", [](int v) { benchmark::DoNotOptimize(v); });
+        return sig.resolve("/telemetry");
+    }();
+    for (auto _ : state) {
+        sig.emit(h, 1);
+    }
+}
+
+using SharedMutexSignal = ccl2::Signal<std::shared_mutex, std::shared_lock>;
+using RcuSignal         = ccl2::Signal<ccl2::RcuMutex, std::shared_lock>;
+
+BENCHMARK_TEMPLATE(BM_signal_emit_concurrent, SharedMutexSignal)->ThreadRange(1, 8);
+BENCHMARK_TEMPLATE(BM_signal_emit_concurrent, RcuSignal)->ThreadRange(1, 8);
+
+// by name on topics matched by a pattern, each emit takes the lock of a shard of the
+// cached matches
+static void BM_signal_emit_wildcard_concurrent(benchmark::State& state) {
+    static RcuSignal sig;
+    static bool init = [] {
+        sig.register_handler("/telemetry/*", [](int v) { benchmark::DoNotOptimize(v); });
+        return true;
+    }();
+    (void)init;
+    auto topic = "/telemetry/" + std::to_string(state.thread_index());
+    for (auto _ : state) {
+        sig.emit(topic, 1);
+    }
+}
+
+BENCHMARK(BM_signal_emit_wildcard_concurrent)->ThreadRange(1, 8);
+
+namespace {
+
+// AsioPool-like enqueue() for emit_on
+struct io_executor {
+    template <class F>
+    void enqueue(F&& f) {
+        boost::asio::post(ioc, std::forward<F>(f));
+    }
+    boost::asio::io_context ioc;
+};
+
+const ccl2::Topic<void(int, double)> kSensor{"/telemetry/sensor/17"};
+
+}  // namespace
+
+static void BM_signal_emit_on(benchmark::State& state) {
+    auto& sig = make_signal();
+    io_executor ex;
+    for (auto _ : state) {
+        for (int i = 0; i < 1000; i++) {
+            sig.emit_on(ex, kSensor.name(), i, 2.0);
+        }
+        ex.ioc.restart();
+        ex.ioc.run();
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+
+BENCHMARK(BM_signal_emit_on);
+
+static void BM_signal_batch_emit(benchmark::State& state) {
+    auto& sig = make_signal();
+    boost::asio::io_context ioc;
+    ccl2::BatchEmitter emitter(sig, kSensor, ioc.get_executor());
+    for (auto _ : state) {
+        for (int i = 0; i < 1000; i++) {
+            emitter.emit(i, 2.0);
+        }
+        emitter.flush();
+        ioc.restart();
+        ioc.run();
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+
+BENCHMARK(BM_signal_batch_emit);
+
+// the emitter only enqueues, the handler runs on the io_context
+static void BM_signal_async_subscriber(benchmark::State& state) {
+    ccl2::Signal<> sig;
+    boost::asio::io_context ioc;
+    ccl2::AsyncSubscriber sub(sig, kSensor, ioc.get_executor(), [](int v, double x) {
+        benchmark::DoNotOptimize(v + x);
+    });
+    for (auto _ : state) {
+        for (int i = 0; i < 1000; i++) {
+            sig.emit(kSensor, i, 2.0);
+        }
+        ioc.restart();
+        ioc.run();
+    }
+    state.SetItemsProcessed(state.iterations() * 1000);
+}
+
+BENCHMARK(BM_signal_async_subscriber);
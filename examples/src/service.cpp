@@ -1,4 +1,5 @@
 #include <memory>
+#include <optional>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
@@ -78,5 +79,15 @@ int main() {
     std::string name = mb.call<std::string>("/get_name");
     fmt::print("name: {}\n", name);
 
+    // the handler runs on the io_context
+    boost::asio::io_context ioc;
+    mb.async_call<int>(ioc.get_executor(), "/algorithm/add", 5, 6,
+                       [](std::exception_ptr e, std::optional<int> r) {
+                           if (!e) {
+                               fmt::print("async a+b={}, expect:{}\n", *r, 11);
+                           }
+                       });
+    ioc.run();
+
     return 0;
 }
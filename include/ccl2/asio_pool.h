@@ -1,38 +1,195 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <system_error>
 #include <thread>
 #include <utility>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/core/noncopyable.hpp>
+#include <ccl2/pool_metrics.h>
 #include <ccl2/singleton_provider.h>
+#include <ccl2/work_stealing_pool.h>
 #include <stddef.h>
 
+#ifdef __linux__
+#    include <linux/mempolicy.h>
+#    include <errno.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
 namespace ccl2 {
 
 class AsioPool final : boost::noncopyable {
 public:
+    /// shared:  one io_context run on all threads (default)
+    /// sharded: one io_context per thread, handlers never migrate between threads
+    enum class mode_t { shared, sharded };
+
+    /// grow/shrink the workers by the busy ratio, @see options_t::autoscale
+    struct autoscale_t {
+        /// 0: disabled
+        size_t max_num = 0;
+        size_t min_num = 1;
+        /// add a worker if the busy ratio of the last interval is above it
+        double grow_above = 0.8;
+        /// remove a worker if the busy ratio of the last interval is below it
+        double shrink_below = 0.2;
+        std::chrono::milliseconds interval{1000};
+    };
+
+    struct options_t {
+        /// the number of threads that io_context run on.
+        size_t num = std::thread::hardware_concurrency();
+        /// scheduling mode, @see mode_t
+        mode_t mode = mode_t::shared;
+        /// pin worker `i` to `cpus[i % cpus.size()]`, empty: no affinity.
+        /// The thread calling run() is worker 0, its affinity, name and memory policy
+        /// are restored when run() returns.
+        std::vector<int> cpus = {};
+        /// thread name prefix, workers are named `<name>-<i>`, empty: keep unnamed
+        std::string name = {};
+        /// bind the allocations of each worker to its local NUMA node
+        bool numa_local = false;
+        /// measure handler run time and delay, @see metrics()
+        bool metrics = false;
+        /// shared mode only, needs `metrics`
+        autoscale_t autoscale = {};
+    };
+
+    /// executor of the io_context, counts the handlers and records their timing if
+    /// metrics are enabled
+    using executor_type = instrumented_executor<boost::asio::io_context::executor_type>;
+
     /// @param num: the number of threads that io_context run on.
-    explicit AsioPool(size_t num = std::thread::hardware_concurrency())
-      : ctx_(num)
+    /// @param mode: scheduling mode, @see mode_t
+    explicit AsioPool(size_t num = std::thread::hardware_concurrency(),
+                      mode_t mode = mode_t::shared)
+      : AsioPool(options_t{num, mode}) {}
+
+    explicit AsioPool(options_t options)
+      : options_(std::move(options))
+      , metrics_(options_.num, options_.metrics)
       , stopped_(false)
-      , worker_count_(num)
-      , work_guard_(boost::asio::make_work_guard(ctx_)) {
-        if (num <= 0) {
+      , draining_(false)
+      , rejected_(0)
+      , dropped_(0)
+      , worker_count_(options_.num)
+      , mode_(options_.mode)
+      , next_(0) {
+        if (options_.num <= 0) {
             throw std::runtime_error("Expect: num >= 1");
         }
+        if (options_.autoscale.max_num > 0
+            && (mode_ != mode_t::shared || !options_.metrics
+                || options_.autoscale.min_num < 1
+                || options_.autoscale.min_num > options_.autoscale.max_num)) {
+            throw std::runtime_error(
+                "Expect: autoscale in shared mode with metrics, 1 <= min <= max");
+        }
+        check_thread_options();
+
+        size_t shards = mode_ == mode_t::sharded ? options_.num : 1;
+        int hint      = concurrency_hint();
+        ctxs_.reserve(shards);
+        work_guards_.reserve(shards);
+        for (size_t i = 0; i < shards; i++) {
+            ctxs_.emplace_back(std::make_unique<boost::asio::io_context>(hint));
+            work_guards_.emplace_back(boost::asio::make_work_guard(*ctxs_.back()));
+        }
     }
 
-    ~AsioPool() { shutdown(); }
+    ~AsioPool() {
+        shutdown();
+        join_watchdog();
+    }
+
+    inline mode_t mode() const { return mode_; }
+
+    inline const options_t& options() const { return options_; }
+
+    inline size_t shard_count() const { return ctxs_.size(); }
+
+    /// In sharded mode, the io_context is picked round-robin. Objects created on it
+    /// (sockets, timers, strands) stay on that shard for their whole lifetime.
+    inline boost::asio::io_context& get_io_context() { return *ctxs_[next_shard()]; }
 
-    inline boost::asio::io_context& get_io_context() { return ctx_; }
+    /// Pick the shard by key, the same key always maps to the same shard.
+    template <class Key>
+    inline boost::asio::io_context& get_io_context(const Key& key) {
+        return *ctxs_[std::hash<Key>{}(key) % ctxs_.size()];
+    }
+
+    /// The shard the calling thread is running, or nullptr if it is not a worker.
+    inline boost::asio::io_context* this_io_context() const {
+        auto* ctx = current_context();
+        for (const auto& c : ctxs_) {
+            if (c.get() == ctx) {
+                return ctx;
+            }
+        }
+        return nullptr;
+    }
+
+    inline executor_type get_executor() { return make_executor(get_io_context()); }
+
+    template <class Key>
+    inline executor_type get_executor(const Key& key) {
+        return make_executor(get_io_context(key));
+    }
 
     template <class CompletionToken>
     auto enqueue(CompletionToken&& token) {
-        return boost::asio::dispatch(ctx_, std::forward<CompletionToken>(token));
+        if (draining_.load(std::memory_order_acquire)) {
+            return reject(std::forward<CompletionToken>(token));
+        }
+        return boost::asio::dispatch(get_executor(),
+                                     std::forward<CompletionToken>(token));
+    }
+
+    template <class Key, class CompletionToken>
+    auto enqueue(const Key& key, CompletionToken&& token) {
+        if (draining_.load(std::memory_order_acquire)) {
+            return reject(std::forward<CompletionToken>(token));
+        }
+        return boost::asio::dispatch(get_executor(key),
+                                     std::forward<CompletionToken>(token));
+    }
+
+    /// Handlers submitted by `enqueue()` or run on `get_executor()` are measured,
+    /// the ones posted to `get_io_context()` directly are not.
+    /// `queued` is always counted, the timing needs `options_t::metrics`.
+    PoolMetrics::snapshot_t metrics() const { return metrics_.snapshot(); }
+
+    /// Executor of the work-stealing pool for compute-bound tasks, it keeps them
+    /// off the io threads. The pool is started on first use with `num` threads.
+    /// The exceptions of plain tasks are dropped, co_spawn on it to get them.
+    WorkStealingPool::executor_type get_compute_executor() {
+        std::lock_guard _lck{compute_mtx_};
+        if (!compute_) {
+            compute_ = std::make_unique<WorkStealingPool>(options_.num);
+            if (stopped_.load(std::memory_order_acquire)) {
+                compute_->shutdown();
+            }
+        }
+        return compute_->get_executor();
+    }
+
+    template <class CompletionToken>
+    auto enqueue_compute(CompletionToken&& token) {
+        return boost::asio::post(get_compute_executor(),
+                                 std::forward<CompletionToken>(token));
     }
 
     void run() {
@@ -40,37 +197,453 @@ public:
             return;
         }
 
-        std::vector<std::thread> threads_;
-        threads_.reserve(worker_count_ - 1);
-        for (size_t i = 0; i < worker_count_ - 1; i++) {
-            threads_.emplace_back([&] { ctx_.run(); });
+        {
+            std::lock_guard _lck{workers_mtx_};
+            running_        = true;
+            caller_running_ = true;
+            for (size_t i = 1; i < worker_count_; i++) {
+                spawn_worker(i);
+            }
+        }
+        std::thread scaler;
+        if (options_.autoscale.max_num > 0) {
+            scaler = std::thread([this] { autoscale(); });
         }
 
-        // run on current thread
-        ctx_.run();
+        // run on current thread, it is worker 0
+        {
+            saved_thread_t saved;
+            setup_thread(0);
+            run_context(0, *ctxs_[0]);
+        }
 
-        for (auto& th : threads_) {
-            if (th.joinable()) {
-                th.join();
+        {
+            std::unique_lock _lck{workers_mtx_};
+            // worker 0 may have retired while the others keep running
+            caller_running_ = false;
+            exit_cv_.wait(_lck, [this] {
+                return std::all_of(workers_.begin(), workers_.end(), [](auto& w) {
+                    return w->done.load(std::memory_order_acquire);
+                });
+            });
+            running_ = false;
+            scale_cv_.notify_all();
+        }
+        if (scaler.joinable()) {
+            scaler.join();
+        }
+        for (auto& w : workers_) {
+            w->th.join();
+        }
+        workers_.clear();
+
+        join_watchdog();
+        // the handlers left in the queues will never run
+        size_t abandoned = metrics_.snapshot().queued;
+        dropped_.store(rejected_.load(std::memory_order_relaxed) + abandoned,
+                       std::memory_order_release);
+    }
+
+    inline size_t worker_count() const {
+        return worker_count_.load(std::memory_order_relaxed);
+    }
+
+    /// The number of workers whose affinity, name or memory policy could not be set,
+    /// they run anyway.
+    inline size_t setup_failures() const {
+        return setup_failures_.load(std::memory_order_relaxed);
+    }
+
+    /// Grow or shrink the workers at runtime, shared mode only.
+    ///
+    /// New workers start at once. The removed ones exit after their current handler,
+    /// the in-flight handlers are never interrupted: one exit request is posted per
+    /// removed worker, the thread running it leaves. It may be the thread calling
+    /// run(), which then waits for the others.
+    /// A pool created with `num = 1` and no `autoscale` never grows beyond one thread,
+    /// its io_context is set up for a single thread.
+    void resize(size_t num) {
+        if (num <= 0) {
+            throw std::runtime_error("Expect: num >= 1");
+        }
+        if (mode_ != mode_t::shared) {
+            throw std::runtime_error("Expect: resize in shared mode");
+        }
+        if (num > 1 && concurrency_hint() == 1) {
+            throw std::runtime_error(
+                "Expect: a pool created with num > 1 or autoscale to grow");
+        }
+
+        std::lock_guard _lck{workers_mtx_};
+        size_t cur = worker_count_.exchange(num, std::memory_order_relaxed);
+        if (!running_) {
+            return;
+        }
+
+        reap_workers();
+        if (num > cur) {
+            size_t grow = num - cur;
+            // cancel the pending retirements first
+            for (; grow > 0 && try_retire(); grow--) {
+            }
+            for (; grow > 0; grow--) {
+                spawn_worker(free_index());
+            }
+        } else if (num < cur) {
+            retiring_.fetch_add(cur - num, std::memory_order_acq_rel);
+            // each one takes a thread out of run(), or none if cancelled by a grow
+            for (size_t i = 0; i < cur - num; i++) {
+                boost::asio::post(*ctxs_[0], [this] {
+                    if (try_retire()) {
+                        throw retire_t{};
+                    }
+                });
             }
         }
     }
 
+    /// Stop at once, the queued handlers are abandoned.
     void shutdown() {
         if (!stopped_.exchange(true, std::memory_order_acquire)) {
-            ctx_.stop();
-            work_guard_.reset();
+            for (auto& ctx : ctxs_) {
+                ctx->stop();
+            }
+            release_work_guards();
+
+            std::lock_guard _lck{compute_mtx_};
+            if (compute_) {
+                compute_->shutdown();
+            }
+        }
+    }
+
+    /// Graceful stop, for rolling restarts.
+    ///
+    /// `enqueue()` rejects new tasks from now on, the queued handlers, pending I/O
+    /// and coroutines keep running, `run()` returns once all of them are done. If
+    /// that takes longer than `timeout`, the pool is `shutdown()`.
+    ///
+    /// Does not block, it can be called from a handler. @see dropped()
+    void drain(std::chrono::milliseconds timeout) {
+        if (stopped_.load(std::memory_order_acquire)
+            || draining_.exchange(true, std::memory_order_acq_rel)) {
+            return;
+        }
+        release_work_guards();
+
+        std::lock_guard _lck{drain_mtx_};
+        if (drained_) {
+            return;
+        }
+        watchdog_ = std::thread([this, timeout] {
+            std::unique_lock _lck{drain_mtx_};
+            if (!drain_cv_.wait_for(_lck, timeout, [this] { return drained_; })) {
+                _lck.unlock();
+                shutdown();
+            }
+        });
+    }
+
+    inline bool draining() const { return draining_.load(std::memory_order_acquire); }
+
+    /// After `run()` returns: the number of tasks rejected by `drain()` plus the
+    /// handlers abandoned by `shutdown()`.
+    inline size_t dropped() const { return dropped_.load(std::memory_order_acquire); }
+
+private:
+    // With a hint of 1 the io_context keeps its lock but does not wake other threads
+    // for new handlers, each shard has one thread, a shared pool at most one ever.
+    int concurrency_hint() const {
+        if (mode_ == mode_t::sharded) {
+            return 1;
+        }
+        return static_cast<int>(std::max(options_.num, options_.autoscale.max_num));
+    }
+
+    inline size_t next_shard() {
+        if (ctxs_.size() == 1) {
+            return 0;
+        }
+        return next_.fetch_add(1, std::memory_order_relaxed) % ctxs_.size();
+    }
+
+    static boost::asio::io_context*& current_context() {
+        static thread_local boost::asio::io_context* ctx = nullptr;
+        return ctx;
+    }
+
+    // throws if the thread options can never be applied
+    void check_thread_options() const {
+#ifdef __linux__
+        if (!options_.cpus.empty()) {
+            cpu_set_t allowed;
+            CPU_ZERO(&allowed);
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+                throw std::system_error(errno, std::generic_category(),
+                                        "sched_getaffinity");
+            }
+            for (int cpu : options_.cpus) {
+                if (cpu < 0 || cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+                    throw std::runtime_error("Expect: cpus allowed to the process, got "
+                                             + std::to_string(cpu));
+                }
+            }
+        }
+        if (options_.numa_local) {
+            int mode = 0;
+            if (syscall(SYS_get_mempolicy, &mode, nullptr, 0, nullptr, 0) != 0) {
+                throw std::system_error(errno, std::generic_category(),
+                                        "Expect: numa_local supported, get_mempolicy");
+            }
+        }
+#endif
+    }
+
+    // Runs on the worker threads and must not throw, a failure is only counted.
+    // The options were checked by the constructor, it may still fail if the affinity
+    // of the process changed since, or a seccomp policy denies set_mempolicy.
+    void setup_thread(size_t index) {
+#ifdef __linux__
+        bool ok = true;
+        if (!options_.cpus.empty()) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(options_.cpus[index % options_.cpus.size()], &cpuset);
+            ok = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) == 0;
+        }
+
+        if (!options_.name.empty()) {
+            // the name is restricted to 16 characters, including the terminating null
+            std::string name = options_.name + "-" + std::to_string(index);
+            name.resize(std::min<size_t>(name.size(), 15));
+            pthread_setname_np(pthread_self(), name.c_str());
+        }
+
+        if (options_.numa_local) {
+            // the pages are allocated on the node of the cpu which touches them first
+            ok = syscall(SYS_set_mempolicy, MPOL_LOCAL, nullptr, 0) == 0 && ok;
+        }
+        if (!ok) {
+            setup_failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+#else
+        (void)index;
+#endif
+    }
+
+    // the settings of the thread calling run(), restored by the destructor
+    struct saved_thread_t {
+#ifdef __linux__
+        saved_thread_t() {
+            CPU_ZERO(&cpus);
+            has_cpus   = sched_getaffinity(0, sizeof(cpus), &cpus) == 0;
+            has_name   = pthread_getname_np(pthread_self(), name, sizeof(name)) == 0;
+            has_policy = syscall(SYS_get_mempolicy, &policy, nodes, kMaxNode, nullptr, 0)
+                         == 0;
+        }
+
+        ~saved_thread_t() {
+            if (has_cpus) {
+                pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            }
+            if (has_name) {
+                pthread_setname_np(pthread_self(), name);
+            }
+            if (has_policy) {
+                syscall(SYS_set_mempolicy, policy, nodes, kMaxNode);
+            }
+        }
+
+        static constexpr unsigned long kMaxNode = 1024;
+
+        cpu_set_t cpus;
+        bool has_cpus = false;
+
+        char name[16] = {0};
+        bool has_name = false;
+
+        int policy      = 0;
+        bool has_policy = false;
+
+        unsigned long nodes[kMaxNode / 8 / sizeof(long)] = {0};
+#endif
+    };
+
+    executor_type make_executor(boost::asio::io_context& ctx) {
+        return executor_type(ctx.get_executor(), &metrics_);
+    }
+
+    template <class CompletionToken>
+    auto reject(CompletionToken&& token) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        // the handler is destroyed without being invoked
+        return boost::asio::async_initiate<CompletionToken, void()>(
+            [](auto&&) {}, token);
+    }
+
+    void release_work_guards() {
+        std::lock_guard _lck{work_guards_mtx_};
+        work_guards_.clear();
+    }
+
+    void join_watchdog() {
+        std::thread th;
+        {
+            std::lock_guard _lck{drain_mtx_};
+            drained_ = true;
+            drain_cv_.notify_all();
+            th = std::move(watchdog_);
+        }
+        if (th.joinable()) {
+            th.join();
+        }
+    }
+
+    void run_context(size_t index, boost::asio::io_context& ctx) {
+        current_context() = &ctx;
+        metrics_.bind_thread(index);
+        try {
+            ctx.run();
+        } catch (const retire_t&) {
+            // removed by resize(), the other threads keep running the io_context
+        }
+        metrics_.unbind_thread();
+        current_context() = nullptr;
+    }
+
+    bool try_retire() {
+        size_t n = retiring_.load(std::memory_order_acquire);
+        while (n > 0) {
+            if (retiring_.compare_exchange_weak(n, n - 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // with `workers_mtx_` held
+    void spawn_worker(size_t index) {
+        metrics_.resize(index + 1);
+        auto& ctx = *ctxs_[index % ctxs_.size()];
+        auto w    = std::make_unique<worker_t>();
+        auto* pw  = w.get();
+        w->index  = index;
+        w->th     = std::thread([this, pw, &ctx] {
+            setup_thread(pw->index);
+            run_context(pw->index, ctx);
+            {
+                std::lock_guard _lck{workers_mtx_};
+                pw->done.store(true, std::memory_order_release);
+            }
+            exit_cv_.notify_all();
+        });
+        workers_.emplace_back(std::move(w));
+    }
+
+    // with `workers_mtx_` held, join the retired workers
+    void reap_workers() {
+        auto it = std::remove_if(workers_.begin(), workers_.end(), [](auto& w) {
+            if (w->done.load(std::memory_order_acquire)) {
+                w->th.join();
+                return true;
+            }
+            return false;
+        });
+        workers_.erase(it, workers_.end());
+    }
+
+    // with `workers_mtx_` held, the smallest index not used by a worker
+    size_t free_index() const {
+        for (size_t i = 0;; i++) {
+            bool used = (i == 0 && caller_running_)
+                        || std::any_of(workers_.begin(), workers_.end(),
+                                       [i](auto& w) { return w->index == i; });
+            if (!used) {
+                return i;
+            }
+        }
+    }
+
+    void autoscale() {
+        const auto& policy = options_.autoscale;
+        uint64_t last_busy = 0;
+        auto last_tp       = PoolMetrics::clock::now();
+
+        std::unique_lock _lck{workers_mtx_};
+        while (running_) {
+            scale_cv_.wait_for(_lck, policy.interval);
+            if (!running_) {
+                break;
+            }
+
+            _lck.unlock();
+            uint64_t busy = 0;
+            for (const auto& t : metrics_.snapshot().threads) {
+                busy += t.busy_ns;
+            }
+            using std::chrono::nanoseconds;
+            auto now   = PoolMetrics::clock::now();
+            auto wall  = std::chrono::duration_cast<nanoseconds>(now - last_tp).count();
+            size_t cur = worker_count();
+
+            // the busy time of a reused slot restarts from 0, skip this round
+            if (busy >= last_busy && wall > 0) {
+                double ratio = double(busy - last_busy) / double(wall) / double(cur);
+                if (ratio > policy.grow_above && cur < policy.max_num) {
+                    resize(cur + 1);
+                } else if (ratio < policy.shrink_below && cur > policy.min_num) {
+                    resize(cur - 1);
+                }
+            }
+            last_busy = busy;
+            last_tp   = now;
+            _lck.lock();
         }
     }
 
 private:
-    boost::asio::io_context ctx_;
+    const options_t options_;
+    PoolMetrics metrics_;
+    std::vector<std::unique_ptr<boost::asio::io_context>> ctxs_;
     std::atomic<bool> stopped_;
-    const size_t worker_count_;
+    std::atomic<bool> draining_;
+    std::atomic<size_t> rejected_;
+    std::atomic<size_t> dropped_;
+    std::atomic<size_t> worker_count_;
+    std::atomic<size_t> setup_failures_{0};
+    const mode_t mode_;
+    std::atomic<size_t> next_;
 
-    // prevent the run() method from return.
-    typedef boost::asio::io_context::executor_type ExecutorType;
-    boost::asio::executor_work_guard<ExecutorType> work_guard_;
+    // workers besides the thread calling run()
+    struct worker_t {
+        size_t index = 0;
+        std::thread th;
+        std::atomic<bool> done{false};
+    };
+    // thrown by a handler to take its thread out of run()
+    struct retire_t {};
+    std::mutex workers_mtx_;
+    std::condition_variable scale_cv_;
+    // a worker is done
+    std::condition_variable exit_cv_;
+    std::vector<std::unique_ptr<worker_t>> workers_;
+    std::atomic<size_t> retiring_{0};
+    bool running_ = false;
+    // the thread calling run() is worker 0 until it retires
+    bool caller_running_ = false;
+
+    std::mutex work_guards_mtx_;
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>
+        work_guards_;
+
+    // stops the pool if drain() times out
+    std::mutex drain_mtx_;
+    std::condition_variable drain_cv_;
+    std::thread watchdog_;
+    bool drained_ = false;
+
+    std::mutex compute_mtx_;
+    std::unique_ptr<WorkStealingPool> compute_;
 };
 
 /// AsioPool Singleton
@@ -82,9 +655,17 @@ static std::once_flag kAsioPoolInitFlag;
 }  // namespace detail
 
 /// C-like interface
-inline void asio_pool_init(size_t num = std::thread::hardware_concurrency()) {
-    std::call_once(detail::kAsioPoolInitFlag,
-                   [&, num] { detail::kAsioPool = std::make_unique<AsioPool>(num); });
+inline void asio_pool_init(size_t num            = std::thread::hardware_concurrency(),
+                           AsioPool::mode_t mode = AsioPool::mode_t::shared) {
+    std::call_once(detail::kAsioPoolInitFlag, [&, num, mode] {
+        detail::kAsioPool = std::make_unique<AsioPool>(num, mode);
+    });
+}
+
+inline void asio_pool_init(AsioPool::options_t options) {
+    std::call_once(detail::kAsioPoolInitFlag, [&] {
+        detail::kAsioPool = std::make_unique<AsioPool>(std::move(options));
+    });
 }
 
 inline void asio_pool_run() {
@@ -107,4 +688,10 @@ auto asio_pool_enqueue(CompletionToken&& token) {
     return detail::kAsioPool->enqueue(std::forward<CompletionToken>(token));
 }
 
+template <class CompletionToken>
+auto asio_pool_enqueue_compute(CompletionToken&& token) {
+    asio_pool_init();
+    return detail::kAsioPool->enqueue_compute(std::forward<CompletionToken>(token));
+}
+
 }  // namespace ccl2
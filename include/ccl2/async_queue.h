@@ -4,87 +4,829 @@
 #    error "Please rebuild with CCL2_WITH_COROUTINES"
 #endif
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/core/noncopyable.hpp>
+#include <boost/version.hpp>
 #include <ccl2/asio_pool.h>
+#include <ccl2/ring_buffer.h>
 #include <ccl2/singleton_provider.h>
+#include <stddef.h>
+
+// per-operation cancellation of pop() and select()
+#if BOOST_VERSION < 107700
+#    error "Please rebuild with boost >= 1.77"
+#endif
 
 namespace ccl2 {
 
+namespace detail {
+
+//!
+//! Completion handler of a parked coroutine, type-erased.
+//!
+//! It holds a work guard of the handler's executor, so the io_context does not run
+//! out of work while the coroutine is waiting.
+//!
+template <class... Args>
+class async_waiter {
+    struct base {
+        virtual ~base()                = default;
+        virtual void complete(Args...) = 0;
+    };
+
+    template <class Handler>
+    struct impl final : base {
+        explicit impl(Handler&& h)
+          : handler(std::move(h)), work(boost::asio::make_work_guard(handler)) {}
+
+        void complete(Args... args) override {
+            auto ex = work.get_executor();
+            boost::asio::post(ex, [h = std::move(handler), args...]() mutable {
+                std::move(h)(std::move(args)...);
+            });
+            work.reset();
+        }
+
+        Handler handler;
+        boost::asio::executor_work_guard<
+            boost::asio::associated_executor_t<Handler, boost::asio::system_executor>>
+            work;
+    };
+
+public:
+    async_waiter() = default;
+
+    template <class Handler>
+    explicit async_waiter(Handler&& h)
+      : impl_(std::make_unique<impl<std::decay_t<Handler>>>(std::forward<Handler>(h))) {}
+
+    explicit operator bool() const { return impl_ != nullptr; }
+
+    /// resume the coroutine on its own executor, at most once
+    void complete(Args... args) {
+        if (auto p = std::move(impl_)) {
+            p->complete(std::move(args)...);
+        }
+    }
+
+private:
+    std::unique_ptr<base> impl_;
+};
+
+//!
+//! One-shot resumption of a parked coroutine.
+//!
+//! It is claimed by the first of notify, deadline or cancellation, the others find
+//! it claimed and let it go. `select()` shares one ticket among several lists.
+//!
+//! The initiation function holds the ticket until it is done, so the coroutine is
+//! never resumed on another thread while the initiation is still running.
+//!
+struct wait_ticket {
+    static constexpr size_t kTimeout   = size_t(-1);
+    static constexpr size_t kCancelled = size_t(-2);
+
+    std::atomic<bool> claimed{false};
+    std::atomic<int> holds{2};
+    size_t result = 0;
+    async_waiter<size_t> waiter;
+    std::weak_ptr<boost::asio::steady_timer> timer;
+
+    bool claim() { return !claimed.exchange(true, std::memory_order_acq_rel); }
+
+    /// after a successful `claim()`
+    void complete(size_t index) {
+        if (auto t = timer.lock()) {
+            t->cancel();
+        }
+        result = index;
+        release();
+    }
+
+    /// called once by the initiation function, and once by `complete()`
+    void release() {
+        if (holds.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            waiter.complete(result);
+        }
+    }
+
+    bool resume(size_t index) {
+        if (!claim()) {
+            return false;
+        }
+        complete(index);
+        return true;
+    }
+
+    /// call `f` when the handler's cancellation slot is emitted
+    template <class Handler, class F>
+    static void on_cancel(Handler& handler, F&& f) {
+        auto slot = boost::asio::get_associated_cancellation_slot(handler);
+        if (slot.is_connected()) {
+            slot.assign([f = std::forward<F>(f)](boost::asio::cancellation_type) mutable {
+                f();
+            });
+        }
+    }
+};
+
+//!
+//! FIFO of parked coroutines, resumed one by one.
+//!
+//! `notify()` costs a fence and an atomic load while nobody is parked, the mutex is
+//! only taken to park or resume a waiter.
+//!
+class waiter_list : boost::noncopyable {
+    struct node_t {
+        std::shared_ptr<wait_ticket> ticket;
+        size_t index;
+    };
+
+public:
+    using clock = std::chrono::steady_clock;
+
+    waiter_list() : size_(0) {}
+
+    /// park until notified. `ready` is checked again once parked, if it is already
+    /// true a waiter is resumed, so a notify racing with the park is not lost.
+    /// Throws `boost::system::system_error` if the coroutine is cancelled.
+    template <class Ready>
+    boost::asio::awaitable<void> wait(Ready ready) {
+        co_await park(std::move(ready), std::nullopt);
+    }
+
+    /// @return: false if the deadline is reached before being notified
+    template <class Ready>
+    boost::asio::awaitable<bool> wait_until(clock::time_point deadline, Ready ready) {
+        co_return co_await park(std::move(ready), deadline) != wait_ticket::kTimeout;
+    }
+
+    /// queue a ticket which is resumed with `index`
+    void add(std::shared_ptr<wait_ticket> ticket, size_t index) {
+        std::lock_guard _lck{mtx_};
+        waiters_.push_back(node_t{std::move(ticket), index});
+        size_.store(waiters_.size(), std::memory_order_relaxed);
+    }
+
+    void erase(const std::shared_ptr<wait_ticket>& ticket) {
+        std::lock_guard _lck{mtx_};
+        auto it = std::find_if(waiters_.begin(), waiters_.end(),
+                               [&](const node_t& n) { return n.ticket == ticket; });
+        if (it != waiters_.end()) {
+            waiters_.erase(it);
+            size_.store(waiters_.size(), std::memory_order_relaxed);
+        }
+    }
+
+    /// resume at most `n` waiters in FIFO order
+    /// @return: the number of waiters resumed
+    size_t notify(size_t n = 1) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (size_.load(std::memory_order_relaxed) == 0) {
+            return 0;
+        }
+
+        size_t r = 0;
+        while (r < n) {
+            node_t node;
+            {
+                std::lock_guard _lck{mtx_};
+                if (waiters_.empty()) {
+                    break;
+                }
+                node = std::move(waiters_.front());
+                waiters_.pop_front();
+                size_.store(waiters_.size(), std::memory_order_relaxed);
+            }
+            // skip the ones timed out, cancelled or won by another list
+            if (node.ticket->resume(node.index)) {
+                r++;
+            }
+        }
+        return r;
+    }
+
+    size_t notify_all() { return notify(size_t(-1)); }
+
+    size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+    template <class Ready>
+    boost::asio::awaitable<size_t> park(Ready ready,
+                                        std::optional<clock::time_point> deadline) {
+        size_t r = co_await boost::asio::async_initiate<
+            const boost::asio::use_awaitable_t<>&, void(size_t)>(
+            [self = this, check = std::move(ready), deadline](auto handler) mutable {
+                auto ticket = std::make_shared<wait_ticket>();
+                auto ex     = boost::asio::get_associated_executor(handler);
+                wait_ticket::on_cancel(handler, [self, ticket] {
+                    if (ticket->claim()) {
+                        self->erase(ticket);
+                        ticket->complete(wait_ticket::kCancelled);
+                    }
+                });
+                ticket->waiter = async_waiter<size_t>(std::move(handler));
+
+                if (deadline) {
+                    using timer_t = boost::asio::steady_timer;
+                    auto timer    = std::make_shared<timer_t>(ex, *deadline);
+                    ticket->timer = timer;
+                    timer->async_wait([self, ticket, timer](boost::system::error_code e) {
+                        if (!e && ticket->claim()) {
+                            self->erase(ticket);
+                            ticket->complete(wait_ticket::kTimeout);
+                        }
+                    });
+                }
+                self->add(ticket, 0);
+
+                // pairs with the fence in `notify()`
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (check()) {
+                    self->notify();
+                }
+                ticket->release();
+            },
+            boost::asio::use_awaitable);
+
+        if (r == wait_ticket::kCancelled) {
+            throw boost::system::system_error(boost::asio::error::operation_aborted);
+        }
+        co_return r;
+    }
+
+private:
+    std::atomic<size_t> size_;
+    std::mutex mtx_;
+    std::deque<node_t> waiters_;
+};
+
+}  // namespace detail
+
+//!
+//! Multi-producer multi-consumer queue for coroutines.
+//!
+//! Producers push into a lock-free ring, the mutex is only taken when the ring is
+//! full and items spill into an overflow list, and then until that list is drained.
+//! A consumer is resumed only if it is actually parked, a push to busy consumers
+//! costs no wakeup.
+//!
+//! Parked consumers wait in FIFO order and a push resumes exactly one of them, so a
+//! pool of worker coroutines can share one queue with `pop_one()` or `pop_batch()`.
+//! `pop()` takes everything and is meant for a single consumer.
+//!
+//! `close()` ends the stream: the items already queued are still popped, then the
+//! consumers get an empty result (`std::nullopt` for `pop_one()`).
+//!
 template <class T>
 class AsyncQueue : boost::noncopyable {
 public:
     using value_type = T;
     using queue_type = std::list<T>;
-    using time_point = boost::asio::steady_timer::clock_type::time_point;
+    using batch_type = std::vector<T>;
+    using clock      = std::chrono::steady_clock;
+
+    static constexpr size_t kDefaultCapacity = 1024;
 
     AsyncQueue() : AsyncQueue(asio_pool_get_io_context()) {}
 
-    explicit AsyncQueue(boost::asio::io_context& ioc) : strand_(ioc), timer_(ioc) {}
+    /// @param capacity: size of the lock-free ring, the queue itself is unbounded.
+    /// The consumer is resumed on its own executor, `ioc` is kept for compatibility.
+    explicit AsyncQueue(boost::asio::io_context& ioc, size_t capacity = kDefaultCapacity)
+      : items_(capacity), closed_(false) {
+        (void)ioc;
+    }
 
-    void push(value_type&& v) {
-        {
-            std::lock_guard _lock{queue_mtx_};
-            queue_.emplace_back(std::move(v));
+    /// @return: false if the queue is closed
+    bool push(value_type&& v) {
+        if (closed()) {
+            return false;
         }
-        wake();
+        items_.push(std::move(v));
+        consumers_.notify();
+        return true;
     }
 
+    /// @return: empty once the queue is closed and drained, or if `wake()` is called
+    /// while parked
     boost::asio::awaitable<queue_type> pop() {
-        queue_type r = try_pop();
-        if (r.size() > 0) {
-            co_return r;
+        size_t wakes = wakes_.load(std::memory_order_acquire);
+        for (;;) {
+            // read before taking, so the items pushed before `close()` are not missed
+            bool eos     = closed();
+            queue_type r = try_pop();
+            if (!r.empty() || eos || woken(wakes)) {
+                co_return r;
+            }
+            co_await consumers_.wait([this, wakes] { return ready() || woken(wakes); });
         }
+    }
 
-        // wait for event
-        co_await boost::asio::dispatch(strand_, boost::asio::use_awaitable);
-        boost::system::error_code ec;
-        timer_.expires_at(time_point::max(), ec);
-        if (!ec) {
-            std::ignore = co_await timer_.async_wait(
-                boost::asio::as_tuple(boost::asio::use_awaitable));
+    /// take one item, the other parked consumers stay parked
+    /// @return: std::nullopt once the queue is closed and drained
+    boost::asio::awaitable<std::optional<value_type>> pop_one() {
+        for (;;) {
+            bool eos = closed();
+            auto v   = try_pop_one();
+            if (v || eos) {
+                co_return v;
+            }
+            co_await consumers_.wait([this] { return ready(); });
         }
+    }
 
-        std::lock_guard _lock{queue_mtx_};
-        r = std::move(queue_);
+    //! Linger-style batching, e.g. for database or log flushes:
+    //!
+    //!     for (;;) {
+    //!         auto batch = co_await q.pop_batch(512, std::chrono::milliseconds(10));
+    //!         if (!batch.empty()) write(batch);
+    //!     }
+    //!
+    /// wait until `max_items` are taken or `max_wait` is elapsed
+    /// @return: at most `max_items` items in FIFO order, empty if nothing came in time
+    boost::asio::awaitable<batch_type> pop_batch(size_t max_items,
+                                                 clock::duration max_wait) {
+        auto deadline = clock::now() + max_wait;
+        batch_type r;
+        for (;;) {
+            bool eos = closed();
+            items_.take(r, max_items - r.size());
+            if (r.size() >= max_items || eos) {
+                break;
+            }
+            if (!co_await consumers_.wait_until(deadline, [this] { return ready(); })) {
+                break;
+            }
+        }
         co_return r;
     }
 
     queue_type try_pop() {
         queue_type r;
-        if (queue_mtx_.try_lock()) {
-            r = std::move(queue_);
-            queue_mtx_.unlock();
+        items_.take(r, size_t(-1));
+        return r;
+    }
+
+    std::optional<value_type> try_pop_one() { return items_.try_pop(); }
+
+    int size() const { return items_.size(); }
+
+    bool empty() const { return items_.empty(); }
+
+    /// the number of parked consumers
+    size_t waiting() const { return consumers_.size(); }
+
+    /// resume all the parked consumers, a parked `pop()` returns even if it is empty,
+    /// `pop_one()` and `pop_batch()` park again
+    void wake() {
+        wakes_.fetch_add(1, std::memory_order_release);
+        consumers_.notify_all();
+    }
+
+    /// stop accepting items and resume all the parked consumers
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        consumers_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    /// a pop would not suspend
+    bool ready() const { return !empty() || closed(); }
+
+    /// used by `ccl2::select()`
+    detail::waiter_list& waiters() { return consumers_; }
+
+private:
+    bool woken(size_t wakes) const {
+        return wakes_.load(std::memory_order_acquire) != wakes;
+    }
+
+private:
+    detail::spill_queue<T> items_;
+
+    std::atomic<bool> closed_;
+    // bumped by `wake()`
+    std::atomic<size_t> wakes_{0};
+    detail::waiter_list consumers_;
+};
+
+template <class T>
+using AsyncQueueProvider = SingletonProvider<AsyncQueue<T>>;
+
+//!
+//! AsyncQueue with a fixed number of priority lanes, lane 0 is the highest.
+//!
+//! Control messages (config reloads, health checks) go to a high lane and do not
+//! queue behind bulk data. Pops take from the highest non-empty lane, unless a lower
+//! lane is starving: once it has been passed over `starvation_limit` times while
+//! holding items, its next item goes first.
+//!
+template <class T, size_t Lanes = 3>
+class PriorityAsyncQueue : boost::noncopyable {
+    static_assert(Lanes > 0, "Expect: Lanes >= 1");
+
+public:
+    using value_type = T;
+    using queue_type = std::list<T>;
+    using batch_type = std::vector<T>;
+    using clock      = std::chrono::steady_clock;
+
+    static constexpr size_t kLanes           = Lanes;
+    static constexpr size_t kDefaultCapacity = 256;
+
+    /// @param starvation_limit: 0 for strict priority
+    /// @param capacity: size of the lock-free ring of each lane
+    explicit PriorityAsyncQueue(size_t starvation_limit = 64,
+                                size_t capacity         = kDefaultCapacity)
+      : limit_(starvation_limit), closed_(false) {
+        for (size_t i = 0; i < Lanes; i++) {
+            lanes_[i].items   = std::make_unique<detail::spill_queue<T>>(capacity);
+            lanes_[i].skipped = 0;
+        }
+    }
+
+    /// @return: false if the queue is closed
+    bool push(value_type&& v, size_t lane) {
+        if (lane >= Lanes) {
+            throw std::runtime_error("Expect: lane < Lanes");
+        }
+        if (closed()) {
+            return false;
+        }
+        lanes_[lane].items->push(std::move(v));
+        consumers_.notify();
+        return true;
+    }
+
+    /// @return: empty once the queue is closed and drained
+    boost::asio::awaitable<queue_type> pop() {
+        for (;;) {
+            bool eos     = closed();
+            queue_type r = try_pop();
+            if (!r.empty() || eos) {
+                co_return r;
+            }
+            co_await consumers_.wait([this] { return ready(); });
+        }
+    }
+
+    /// @return: std::nullopt once the queue is closed and drained
+    boost::asio::awaitable<std::optional<value_type>> pop_one() {
+        for (;;) {
+            bool eos = closed();
+            auto v   = try_pop_one();
+            if (v || eos) {
+                co_return v;
+            }
+            co_await consumers_.wait([this] { return ready(); });
+        }
+    }
+
+    /// same as `AsyncQueue::pop_batch()`, in priority order
+    boost::asio::awaitable<batch_type> pop_batch(size_t max_items,
+                                                 clock::duration max_wait) {
+        auto deadline = clock::now() + max_wait;
+        batch_type r;
+        for (;;) {
+            bool eos = closed();
+            take(r, max_items);
+            if (r.size() >= max_items || eos) {
+                break;
+            }
+            if (!co_await consumers_.wait_until(deadline, [this] { return ready(); })) {
+                break;
+            }
         }
+        co_return r;
+    }
+
+    /// everything, in priority order
+    queue_type try_pop() {
+        queue_type r;
+        take(r, size_t(-1));
         return r;
     }
 
-    int size() const {
-        std::unique_lock _lock{queue_mtx_};
-        return queue_.size();
+    std::optional<value_type> try_pop_one() {
+        if (limit_ > 0) {
+            // the lowest starving lane first, it has waited the longest
+            for (size_t i = Lanes; i-- > 1;) {
+                auto& lane = lanes_[i];
+                if (lane.skipped.load(std::memory_order_relaxed) >= limit_) {
+                    lane.skipped.store(0, std::memory_order_relaxed);
+                    if (auto v = lane.items->try_pop()) {
+                        return v;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < Lanes; i++) {
+            if (auto v = lanes_[i].items->try_pop()) {
+                if (limit_ > 0) {
+                    for (size_t j = i + 1; j < Lanes; j++) {
+                        if (!lanes_[j].items->empty()) {
+                            lanes_[j].skipped.fetch_add(1, std::memory_order_relaxed);
+                        }
+                    }
+                }
+                return v;
+            }
+        }
+        return std::nullopt;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& lane : lanes_) {
+            n += lane.items->size();
+        }
+        return n;
     }
 
+    size_t size(size_t lane) const { return lanes_.at(lane).items->size(); }
+
     bool empty() const { return size() == 0; }
 
-    void wake() {
-        boost::asio::dispatch(strand_, [this] {
-            boost::system::error_code ec;
-            timer_.cancel(ec);
-        });
+    inline size_t starvation_limit() const { return limit_; }
+
+    /// the number of parked consumers
+    size_t waiting() const { return consumers_.size(); }
+
+    /// stop accepting items and resume all the parked consumers
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        consumers_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    /// a pop would not suspend
+    bool ready() const { return !empty() || closed(); }
+
+    /// used by `ccl2::select()`
+    detail::waiter_list& waiters() { return consumers_; }
+
+private:
+    template <class Container>
+    void take(Container& r, size_t max) {
+        while (r.size() < max) {
+            auto v = try_pop_one();
+            if (!v) {
+                break;
+            }
+            r.emplace_back(std::move(*v));
+        }
     }
 
 private:
-    // mutable std::mutex queue_mtx_;
-    mutable std::recursive_mutex queue_mtx_;
-    queue_type queue_;
+    struct alignas(64) lane_t {
+        std::unique_ptr<detail::spill_queue<T>> items;
+        std::atomic<size_t> skipped;
+    };
 
-    boost::asio::io_context::strand strand_;
-    boost::asio::steady_timer timer_;
+    const size_t limit_;
+    std::array<lane_t, Lanes> lanes_;
+    std::atomic<bool> closed_;
+    detail::waiter_list consumers_;
 };
 
+//!
+//! Bounded multi-producer multi-consumer queue for coroutines.
+//!
+//! Items live in a fixed-capacity lock-free ring, nothing is allocated per item.
+//! Parked consumers wait in FIFO order and a push resumes one of them. `pop()` takes
+//! everything queued, so with several consumers a batch goes to whoever pops first.
+//! When the ring is full the overflow policy decides:
+//!     - block:       `co_await push(v)` suspends the producer until there is room
+//!     - drop_oldest: the oldest item is evicted to make room for the new one
+//!     - drop_newest: the new item is discarded
+//!
+//! `close()` resumes the blocked producers with false, and the consumers get an
+//! empty result once the queue is drained.
+//!
 template <class T>
-using AsyncQueueProvider = SingletonProvider<AsyncQueue<T>>;
+class BoundedAsyncQueue : boost::noncopyable {
+public:
+    using value_type = T;
+    using queue_type = std::list<T>;
+
+    enum class policy_t { block, drop_oldest, drop_newest };
+
+    /// @param capacity: rounded up to a power of 2
+    explicit BoundedAsyncQueue(size_t capacity, policy_t policy = policy_t::block)
+      : ring_(capacity), policy_(policy), dropped_(0), closed_(false) {}
+
+    /// never suspends. With `block` it fails if the queue is full, and `v` is left
+    /// untouched.
+    /// @return: false if `v` is not queued
+    bool try_push(value_type&& v) {
+        if (closed()) {
+            return false;
+        }
+        for (;;) {
+            if (ring_.try_push(std::move(v))) {
+                consumers_.notify();
+                return true;
+            }
+
+            switch (policy_) {
+            case policy_t::block:
+                return false;
+            case policy_t::drop_newest:
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case policy_t::drop_oldest:
+                if (ring_.try_pop()) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                }
+                break;
+            }
+        }
+    }
+
+    /// suspends while the queue is full with `block`, otherwise same as `try_push`
+    boost::asio::awaitable<bool> push(value_type v) {
+        for (;;) {
+            if (try_push(std::move(v))) {
+                co_return true;
+            }
+            if (policy_ != policy_t::block || closed()) {
+                co_return false;
+            }
+            co_await producers_.wait([this] { return !full() || closed(); });
+        }
+    }
+
+    /// @return: empty once the queue is closed and drained
+    boost::asio::awaitable<queue_type> pop() {
+        for (;;) {
+            bool eos     = closed();
+            queue_type r = try_pop();
+            if (!r.empty() || eos) {
+                co_return r;
+            }
+            co_await consumers_.wait([this] { return ready(); });
+        }
+    }
+
+    queue_type try_pop() {
+        queue_type r;
+        while (auto v = ring_.try_pop()) {
+            r.emplace_back(std::move(*v));
+        }
+        if (!r.empty()) {
+            producers_.notify(r.size());
+        }
+        return r;
+    }
+
+    size_t size() const { return ring_.size(); }
+
+    bool empty() const { return ring_.empty(); }
+
+    bool full() const { return ring_.size() >= ring_.capacity(); }
+
+    size_t capacity() const { return ring_.capacity(); }
+
+    inline policy_t policy() const { return policy_; }
+
+    /// the number of items discarded by the overflow policy
+    size_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    /// stop accepting items and resume all the parked producers and consumers
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        producers_.notify_all();
+        consumers_.notify_all();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    /// a pop would not suspend
+    bool ready() const { return !empty() || closed(); }
+
+    /// used by `ccl2::select()`
+    detail::waiter_list& waiters() { return consumers_; }
+
+private:
+    detail::ring_buffer<T> ring_;
+    const policy_t policy_;
+    std::atomic<size_t> dropped_;
+    std::atomic<bool> closed_;
+
+    detail::waiter_list producers_;
+    detail::waiter_list consumers_;
+};
+
+namespace detail {
+
+/// a queue with `ready()` and `waiters()`
+template <class S>
+struct select_source {
+    explicit select_source(S& q) : q(q) {}
+
+    bool ready() const { return q.ready(); }
+
+    void arm(const std::shared_ptr<wait_ticket>& ticket, size_t index) {
+        q.waiters().add(ticket, index);
+    }
+
+    void disarm(const std::shared_ptr<wait_ticket>& ticket) { q.waiters().erase(ticket); }
+
+    S& q;
+};
+
+/// waits on a timer of its own, the waits of others on `t` are left alone
+template <class Clock, class WaitTraits, class Executor>
+struct select_source<boost::asio::basic_waitable_timer<Clock, WaitTraits, Executor>> {
+    using timer_type = boost::asio::basic_waitable_timer<Clock, WaitTraits, Executor>;
+
+    explicit select_source(timer_type& t) : t(t) {}
+
+    bool ready() const { return t.expiry() <= Clock::now(); }
+
+    void arm(const std::shared_ptr<wait_ticket>& ticket, size_t index) {
+        own = std::make_shared<timer_type>(t.get_executor(), t.expiry());
+        own->async_wait([ticket, index, timer = own](boost::system::error_code ec) {
+            if (!ec) {
+                ticket->resume(index);
+            }
+        });
+    }
+
+    void disarm(const std::shared_ptr<wait_ticket>&) { own->cancel(); }
+
+    timer_type& t;
+    std::shared_ptr<timer_type> own;
+};
+
+template <class... S, size_t... I>
+void select_arm(const std::shared_ptr<wait_ticket>& ticket, std::index_sequence<I...>,
+                std::tuple<select_source<S>...>& sources) {
+    (std::get<I>(sources).arm(ticket, I), ...);
+
+    // pairs with the fence in `waiter_list::notify()`, a source may be ready already
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    (void)((std::get<I>(sources).ready() && ticket->resume(I)) || ...);
+}
+
+}  // namespace detail
+
+//!
+//! Wait on several queues and timers, resume on whichever becomes ready first.
+//!
+//!     switch (co_await ccl2::select(q1, q2, timer)) {
+//!     case 0: handle(q1.try_pop()); break;
+//!     case 1: handle(q2.try_pop()); break;
+//!     case 2: /* timed out */ break;
+//!     }
+//!
+//! Nothing is popped, with several consumers the queue may be empty again when the
+//! caller gets to it. A closed queue is ready. A timer is waited on by a copy of its
+//! expiry when select() starts, the other waits on it are not cancelled when another
+//! source wins.
+//!
+/// @return: the index of the ready source
+template <class... Sources>
+boost::asio::awaitable<size_t> select(Sources&... sources) {
+    static_assert(sizeof...(Sources) > 0, "select() needs a source");
+
+    auto ticket = std::make_shared<detail::wait_ticket>();
+    std::tuple<detail::select_source<Sources>...> armed{
+        detail::select_source<Sources>(sources)...};
+    size_t r = co_await boost::asio::async_initiate<
+        const boost::asio::use_awaitable_t<>&, void(size_t)>(
+        [&](auto handler) {
+            detail::wait_ticket::on_cancel(
+                handler, [t = ticket] { t->resume(detail::wait_ticket::kCancelled); });
+            ticket->waiter = detail::async_waiter<size_t>(std::move(handler));
+            using indices = std::index_sequence_for<Sources...>;
+            detail::select_arm(ticket, indices{}, armed);
+            ticket->release();
+        },
+        boost::asio::use_awaitable);
+
+    std::apply([&](auto&... s) { (s.disarm(ticket), ...); }, armed);
+    if (r == detail::wait_ticket::kCancelled) {
+        throw boost::system::system_error(boost::asio::error::operation_aborted);
+    }
+    co_return r;
+}
 
 }  // namespace ccl2
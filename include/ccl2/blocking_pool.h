@@ -0,0 +1,206 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/singleton_provider.h>
+#include <stddef.h>
+
+namespace ccl2 {
+
+/// thrown when a job is rejected because the queue of a BlockingPool is full
+class pool_full_error : public std::runtime_error {
+public:
+    pool_full_error() : std::runtime_error("blocking pool is full") {}
+};
+
+//!
+//! Bounded thread pool for blocking jobs (file I/O, blocking libraries ...),
+//! keep them away from the io threads of AsioPool.
+//!
+//! Threads are started on demand, at most `max_threads` jobs run at the same time,
+//! the others wait in a queue of at most `max_queue` jobs.
+//!
+class BlockingPool final : boost::noncopyable {
+public:
+    using job_type = std::function<void()>;
+
+    /// @param max_threads: cap of concurrent blocking jobs
+    /// @param max_queue: cap of queued jobs, 0 for unbounded
+    explicit BlockingPool(size_t max_threads = 16, size_t max_queue = 0)
+      : max_threads_(max_threads), max_queue_(max_queue), idle_(0), active_(0) {
+        if (max_threads <= 0) {
+            throw std::runtime_error("Expect: max_threads >= 1");
+        }
+    }
+
+    ~BlockingPool() {
+        shutdown();
+        for (auto& th : threads_) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+    }
+
+    /// @return: false if the queue is full or the pool is shut down
+    bool try_enqueue(job_type&& job) {
+        std::lock_guard _lck{mtx_};
+        if (stopped_ || (max_queue_ > 0 && jobs_.size() >= max_queue_)) {
+            return false;
+        }
+
+        jobs_.emplace_back(std::move(job));
+        if (idle_ > 0) {
+            cv_.notify_one();
+        }
+        // a burst may queue more jobs than there are idle threads to take them
+        if (jobs_.size() > idle_ + starting_ && threads_.size() < max_threads_) {
+            starting_++;
+            threads_.emplace_back([this] { worker(); });
+        }
+        return true;
+    }
+
+    void enqueue(job_type&& job) {
+        if (!try_enqueue(std::move(job))) {
+            throw pool_full_error();
+        }
+    }
+
+    /// the number of jobs waiting for a thread
+    size_t queue_depth() const {
+        std::lock_guard _lck{mtx_};
+        return jobs_.size();
+    }
+
+    /// the number of jobs running
+    size_t active() const {
+        std::lock_guard _lck{mtx_};
+        return active_;
+    }
+
+    inline size_t max_threads() const { return max_threads_; }
+
+    inline size_t max_queue() const { return max_queue_; }
+
+    /// stop accepting jobs, the running and queued ones are finished.
+    void shutdown() {
+        std::lock_guard _lck{mtx_};
+        stopped_ = true;
+        cv_.notify_all();
+    }
+
+private:
+    void worker() {
+        std::unique_lock _lck{mtx_};
+        starting_--;
+        for (;;) {
+            if (jobs_.empty()) {
+                if (stopped_) {
+                    break;
+                }
+                idle_++;
+                cv_.wait(_lck, [this] { return stopped_ || !jobs_.empty(); });
+                idle_--;
+                continue;
+            }
+
+            auto job = std::move(jobs_.front());
+            jobs_.pop_front();
+            active_++;
+            _lck.unlock();
+            job();
+            _lck.lock();
+            active_--;
+        }
+    }
+
+private:
+    const size_t max_threads_;
+    const size_t max_queue_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<job_type> jobs_;
+    std::vector<std::thread> threads_;
+    size_t idle_;
+    size_t active_;
+    // started, not yet waiting for jobs
+    size_t starting_ = 0;
+    bool stopped_ = false;
+};
+
+/// BlockingPool Singleton
+using BlockingPoolProvider = SingletonProvider<BlockingPool>;
+
+#ifdef CCL2_USE_COROUTINES
+
+//!
+//! Run `fn` on the blocking pool, and resume the coroutine on its own executor.
+//!
+//!     auto content = co_await ccl2::offload([&] { return read_file(path); });
+//!
+//! The exception thrown by `fn` is rethrown in the coroutine, `pool_full_error` is
+//! thrown if the queue of the pool is full, before `fn` is run.
+//!
+template <class F, class R = std::invoke_result_t<std::decay_t<F>&>>
+boost::asio::awaitable<R> offload(BlockingPool& pool, F&& fn) {
+    auto ex = co_await boost::asio::this_coro::executor;
+
+    std::decay_t<F> f(std::forward<F>(fn));
+    std::conditional_t<std::is_void_v<R>, bool, std::optional<R>> result{};
+    std::exception_ptr eptr;
+    bool queued = true;
+
+    co_await boost::asio::async_initiate<const boost::asio::use_awaitable_t<>&, void()>(
+        [&](auto handler) {
+            auto work = boost::asio::make_work_guard(ex);
+            auto job  = std::make_shared<decltype(handler)>(std::move(handler));
+            queued    = pool.try_enqueue([&, job, work]() mutable {
+                try {
+                    if constexpr (std::is_void_v<R>) {
+                        f();
+                    } else {
+                        result.emplace(f());
+                    }
+                } catch (...) {
+                    eptr = std::current_exception();
+                }
+                boost::asio::post(work.get_executor(), std::move(*job));
+            });
+            if (!queued) {
+                boost::asio::post(ex, std::move(*job));
+            }
+        },
+        boost::asio::use_awaitable);
+
+    if (!queued) {
+        throw pool_full_error();
+    }
+    if (eptr) {
+        std::rethrow_exception(eptr);
+    }
+    if constexpr (!std::is_void_v<R>) {
+        co_return std::move(*result);
+    }
+}
+
+template <class F>
+auto offload(F&& fn) {
+    return offload(BlockingPoolProvider::get(), std::forward<F>(fn));
+}
+
+#endif
+
+}  // namespace ccl2
@@ -2,12 +2,32 @@
 
 // refer: https://cloud.tencent.com/developer/ask/sof/104494
 
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
 #include <functional>
+#include <initializer_list>
 #include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <typeinfo>
 #include <boost/callable_traits.hpp>
+#include <boost/core/noncopyable.hpp>
 #include <boost/hana.hpp>
 
+#ifndef CCL2_CHECKED_DISPATCH
+/// verify Args... against the signature a function was bound with on every call by
+/// name. Define it to 0 to skip the check, the same in every translation unit: a
+/// mismatched call is then undefined behavior. The typed calls through a Topic are
+/// checked at compile time either way.
+#    define CCL2_CHECKED_DISPATCH 1
+#endif
+
 namespace ct   = boost::callable_traits;
 namespace hana = boost::hana;
 
@@ -28,96 +48,453 @@ struct tuple_pop_front<std::tuple<T, Ts...>> {
     using type = std::tuple<Ts...>;
 };
 
+// the type of a parameter as it is checked, `void(int, int)` for `(const int&, int)`
+template <class... Args>
+using signature_t = void(std::remove_cvref_t<Args>...);
+
+// the checked type of a signature, `void(int, int)` for `int(const int&, int)`
+template <class Signature>
+using canonical_t = ct::args_t<Signature, signature_t>;
+
+// the type of an argument at the call site, std::reference_wrapper is unwrapped
+template <class X>
+using arg_t = std::remove_cvref_t<std::unwrap_reference_t<std::decay_t<X>>>;
+
+// the bits of the parameters which are non-const lvalue references, and rvalue
+// references, the qualifiers canonical_t does not keep
+template <class... Args>
+struct param_refs {
+    static_assert(sizeof...(Args) <= 64, "Expect: at most 64 parameters");
+
+    template <class A>
+    static constexpr bool is_mutable_ref =
+        std::is_lvalue_reference_v<A> && !std::is_const_v<std::remove_reference_t<A>>;
+
+    static constexpr uint64_t mask(std::initializer_list<bool> bits) {
+        uint64_t m = 0;
+        int i      = 0;
+        for (bool b : bits) {
+            m |= uint64_t(b) << i++;
+        }
+        return m;
+    }
+
+    static constexpr uint64_t mutable_refs = mask({is_mutable_ref<Args>...});
+    static constexpr uint64_t rvalue_refs  = mask({std::is_rvalue_reference_v<Args>...});
+};
+
+// a forwarded argument `X&&`, through a std::reference_wrapper if any
+template <class X>
+struct arg_traits {
+    using bare = std::remove_cvref_t<X>;
+    static constexpr bool is_wrapper =
+        !std::is_same_v<std::unwrap_reference_t<bare>, bare>;
+    // the object referred to, cv-qualified
+    using type = std::remove_reference_t<
+        std::conditional_t<is_wrapper, std::unwrap_reference_t<bare>, X>>;
+    static constexpr bool is_const  = std::is_const_v<type>;
+    static constexpr bool is_lvalue = is_wrapper || std::is_lvalue_reference_v<X>;
+};
+
 }  // namespace detail
 
+//! tag of a callable bound with a checked signature, see ccl2::bind
+template <class Signature>
+struct with_signature_t {
+    explicit with_signature_t() = default;
+};
+
+template <class Signature>
+inline constexpr with_signature_t<Signature> with_signature{};
+
 template <int i>
 using Int2Type = std::integral_constant<int, i>;
+
+#ifndef CCL2_FUNCTION_INLINE_SIZE
+/// callables up to this size are stored inline by ccl2::function, no allocation
+#    define CCL2_FUNCTION_INLINE_SIZE 48
+#endif
+
+//!
+//! Where a raw callable of ccl2::function puts its result, `result` points to one.
+//! The storage comes first, `static_cast<R*>(result)` is the R itself.
+//!
+//! If R is default constructible it is constructed before the call, the callee may
+//! assign to it. Otherwise the callee has to `emplace()` it, a call which constructs
+//! nothing throws std::runtime_error.
+//!
+template <class R>
+struct result_slot : boost::noncopyable {
+    result_slot() {
+        if constexpr (std::is_default_constructible_v<R>) {
+            emplace();
+        }
+    }
+
+    ~result_slot() { reset(); }
+
+    template <class... Ts>
+    R& emplace(Ts&&... ts) {
+        reset();
+        ::new (static_cast<void*>(storage)) R(std::forward<Ts>(ts)...);
+        constructed = true;
+        return *get();
+    }
+
+    void reset() noexcept {
+        if (constructed) {
+            constructed = false;
+            get()->~R();
+        }
+    }
+
+    R* get() noexcept { return std::launder(reinterpret_cast<R*>(storage)); }
+
+    alignas(R) unsigned char storage[sizeof(R)];
+    bool constructed = false;
+};
+
 //!
 //! remap function from
 //!     R (*)(Args...)
 //! to
 //!     void (*)(void *args, void *result)
 //!
-//! @param args:    hana::tuple<Args...>
-//! @param result:  R/void
+//! @param args:    void*[], a pointer to each argument
+//! @param result:  a ccl2::result_slot<R>, nullptr for void
 //!
-template <class R>
+//! Move-only. Callables which fit in `InlineSize` bytes (and are nothrow movable)
+//! live in an inline buffer, the others are allocated once. A call is a single
+//! indirect call through a function pointer.
+//!
+//! Functions made by ccl2::bind remember their parameter types, ccl2::invoke checks
+//! the arguments against them and throws on a mismatch.
+//!
+template <class R, size_t InlineSize = CCL2_FUNCTION_INLINE_SIZE>
 class function {
-    using Func = std::function<void(void*, void*)>;
-    Func callable_;
+    static_assert(InlineSize >= sizeof(void*), "Expect: InlineSize >= sizeof(void*)");
 
-    template <class Fn>
-    auto make_copyable_function(Fn&& f) {
-        using DF = std::decay_t<Fn>;
-        auto spf = std::make_shared<DF>(std::forward<Fn>(f));
-        return [spf](auto&&... args) -> decltype(auto) {
-            return (*spf)(std::forward<decltype(args)>(args)...);
-        };
+    enum class op_t { move, destroy };
+    using invoke_fn = void (*)(void* storage, void* args, void* result);
+    using manage_fn = void (*)(op_t op, void* dst, void* src);
+
+    // shared by all the functions holding the same callable type
+    struct ops_t {
+        manage_fn manage;
+        const std::type_info* signature;
+        uint64_t mutable_refs;
+        uint64_t rvalue_refs;
+    };
+
+    template <class F>
+    static constexpr bool is_inline = sizeof(F) <= InlineSize
+                                      && alignof(F) <= alignof(std::max_align_t)
+                                      && std::is_nothrow_move_constructible_v<F>;
+
+    // moved by memcpy and never destroyed, no manager needed
+    template <class F>
+    static constexpr bool is_trivial = is_inline<F> && std::is_trivially_copyable_v<F>
+                                       && std::is_trivially_destructible_v<F>;
+
+    template <class F>
+    static F* target(void* storage) {
+        if constexpr (is_inline<F>) {
+            return std::launder(reinterpret_cast<F*>(storage));
+        } else {
+            return *std::launder(reinterpret_cast<F**>(storage));
+        }
+    }
+
+    template <class F>
+    static void invoke_impl(void* storage, void* args, void* result) {
+        (*target<F>(storage))(args, result);
+    }
+
+    template <class F>
+    static void manage_impl(op_t op, void* dst, void* src) {
+        if constexpr (is_inline<F>) {
+            F* f = target<F>(src);
+            if (op == op_t::move) {
+                ::new (dst) F(std::move(*f));
+            }
+            f->~F();
+        } else {
+            if (op == op_t::move) {
+                ::new (dst) F*(target<F>(src));
+            } else {
+                delete target<F>(src);
+            }
+        }
     }
 
+    template <class Signature>
+    struct signature_of {
+        using refs = ct::args_t<Signature, detail::param_refs>;
+
+        static inline const std::type_info* const type =
+            &typeid(detail::canonical_t<Signature>);
+        static constexpr uint64_t mutable_refs = refs::mutable_refs;
+        static constexpr uint64_t rvalue_refs  = refs::rvalue_refs;
+    };
+
+    // not checked
+    template <class Signature>
+    struct signature_of_void {
+        static inline const std::type_info* const type = nullptr;
+        static constexpr uint64_t mutable_refs        = 0;
+        static constexpr uint64_t rvalue_refs         = 0;
+    };
+
+    // `Signature` void: not checked
+    template <class F, class Signature>
+    static inline const ops_t ops_v = [] {
+        using S = std::conditional_t<std::is_void_v<Signature>,
+                                     signature_of_void<Signature>,
+                                     signature_of<Signature>>;
+        return ops_t{is_trivial<F> ? nullptr : &manage_impl<F>, S::type, S::mutable_refs,
+                     S::rvalue_refs};
+    }();
+
 public:
     using Ret = R;
 
-    template <class Fn>
+    function() noexcept = default;
+
+    /// a raw callable, `void(void* args, void* result)`, the arguments are not checked.
+    /// `result` is a ccl2::result_slot<R>, see there how to set it.
+    template <class Fn,
+              class = std::enable_if_t<!std::is_same_v<std::decay_t<Fn>, function>>>
     function(Fn&& f) {
-        if constexpr (std::is_copy_assignable_v<std::remove_reference_t<Fn>>) {
-            callable_ = std::move(f);
-        } else {
-            callable_ = make_copyable_function(std::forward<Fn>(f));
+        init<void>(std::forward<Fn>(f));
+    }
+
+    /// a raw callable taking the arguments of `Signature`, `args` points to an rvalue
+    /// or to a copy for an rvalue reference parameter
+    template <class Signature, class Fn>
+    function(with_signature_t<Signature>, Fn&& f) {
+        init<Signature>(std::forward<Fn>(f));
+    }
+
+    function(function&& other) noexcept { take(other); }
+
+    function& operator=(function&& other) noexcept {
+        if (this != &other) {
+            reset();
+            take(other);
         }
+        return *this;
     }
 
-    function(function<R>&& other) : callable_(std::move(other.callable_)) {}
+    function(const function&)            = delete;
+    function& operator=(const function&) = delete;
+
+    ~function() { reset(); }
+
+    explicit operator bool() const noexcept { return invoke_ != nullptr; }
+
+    /// `void(std::remove_cvref_t<Args>...)` of the bound callable, nullptr if unknown
+    const std::type_info* signature() const noexcept {
+        return ops_ ? ops_->signature : nullptr;
+    }
+
+    /// bit i: parameter i is a non-const lvalue reference, 0 if unknown
+    uint64_t mutable_refs() const noexcept { return ops_ ? ops_->mutable_refs : 0; }
+
+    /// bit i: parameter i is an rvalue reference, 0 if unknown
+    uint64_t rvalue_refs() const noexcept { return ops_ ? ops_->rvalue_refs : 0; }
+
+    /// true if the arguments of `Signature` can be passed, always true if unknown
+    template <class Signature>
+    bool accepts() const noexcept {
+        auto* s = signature();
+        return s == nullptr || s == &typeid(Signature) || *s == typeid(Signature);
+    }
 
     void operator()(void* args, void* result) const {
-        if (callable_) {
-            callable_(args, result);
+        if (invoke_) {
+            invoke_(storage_, args, result);
         }
     }
+
+private:
+    template <class Signature, class Fn>
+    void init(Fn&& f) {
+        using F = std::decay_t<Fn>;
+        if constexpr (is_inline<F>) {
+            ::new (static_cast<void*>(storage_)) F(std::forward<Fn>(f));
+        } else {
+            ::new (static_cast<void*>(storage_)) F*(new F(std::forward<Fn>(f)));
+        }
+        invoke_ = &invoke_impl<F>;
+        if constexpr (!is_trivial<F> || !std::is_void_v<Signature>) {
+            ops_ = &ops_v<F, Signature>;
+        }
+    }
+
+    void reset() noexcept {
+        if (ops_ && ops_->manage) {
+            ops_->manage(op_t::destroy, nullptr, storage_);
+        }
+        invoke_ = nullptr;
+        ops_    = nullptr;
+    }
+
+    void take(function& other) noexcept {
+        if (other.ops_ && other.ops_->manage) {
+            other.ops_->manage(op_t::move, storage_, other.storage_);
+        } else if (other.invoke_) {
+            std::memcpy(storage_, other.storage_, InlineSize);
+        }
+        invoke_       = other.invoke_;
+        ops_          = other.ops_;
+        other.invoke_ = nullptr;
+        other.ops_    = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) mutable unsigned char storage_[InlineSize];
+    invoke_fn invoke_ = nullptr;
+    const ops_t* ops_ = nullptr;
+};
+
+namespace detail {
+
+//! the callee side of the protocol of ccl2::function
+template <class Ret, class ArgsTuple>
+struct erased;
+
+template <class Ret, class... Args>
+struct erased<Ret, std::tuple<Args...>> {
+    using signature = void(Args...);
+
+    // by-value and lvalue reference parameters never move from the argument, a
+    // signal passes the same arguments to every handler. ccl2::invoke passes a copy
+    // of an lvalue to an rvalue reference parameter.
+    template <class A>
+    static decltype(auto) arg(void* p) {
+        using T = std::remove_cvref_t<A>;
+        if constexpr (std::is_rvalue_reference_v<A>) {
+            return std::move(*static_cast<T*>(p));
+        } else {
+            return (*static_cast<T*>(p));
+        }
+    }
+
+    template <class Fn, size_t... I>
+    static void call(Fn& fn, void** argv, void* result, std::index_sequence<I...>) {
+        (void)argv;
+        if constexpr (std::is_void_v<Ret>) {
+            std::invoke(fn, arg<Args>(argv[I])...);
+        } else {
+            static_cast<result_slot<Ret>*>(result)->emplace(
+                std::invoke(fn, arg<Args>(argv[I])...));
+        }
+    }
+
+    template <class Fn>
+    static function<Ret> wrap(Fn fn) {
+        static_assert(std::is_invocable_r_v<Ret, Fn&, decltype(arg<Args>(nullptr))...>,
+                      "Expect: the callable accepts the arguments of the signature");
+        // mutable for functor
+        auto f = [fn = std::move(fn)](void* args, void* result) mutable {
+            auto argv = static_cast<void**>(args);
+            call(fn, argv, result, std::index_sequence_for<Args...>{});
+        };
+        return function<Ret>(with_signature<signature>, std::move(f));
+    }
+};
+
+// arrays and functions decay into a temporary, which lives until the call returns
+template <class X>
+decltype(auto) pass_arg(X&& x) {
+    if constexpr (std::is_array_v<std::remove_reference_t<X>>
+                  || std::is_function_v<std::remove_reference_t<X>>) {
+        return std::decay_t<X>(x);
+    } else {
+        return std::forward<X>(x);
+    }
+}
+
+// an argument converted to the parameter type `P`, passed as is if it is one already
+template <class P, class X>
+decltype(auto) convert_arg(X&& x) {
+    using T = std::remove_cvref_t<P>;
+    if constexpr (std::is_same_v<arg_t<X>, T>
+                  && !std::is_array_v<std::remove_reference_t<X>>
+                  && !std::is_function_v<std::remove_reference_t<X>>) {
+        return std::forward<X>(x);
+    } else {
+        static_assert(std::is_convertible_v<X&&, T>,
+                      "Expect: the argument converts to the parameter");
+        return T(std::forward<X>(x));
+    }
+}
+
+template <class X>
+void* arg_address(X& x) noexcept {
+    if constexpr (std::is_same_v<std::unwrap_reference_t<std::remove_cv_t<X>>,
+                                 std::remove_cv_t<X>>) {
+        return const_cast<void*>(static_cast<const void*>(std::addressof(x)));
+    } else {
+        return const_cast<void*>(static_cast<const void*>(std::addressof(x.get())));
+    }
+}
+
+// the copy of an lvalue argument passed to an rvalue reference parameter
+template <class X>
+struct arg_copy {
+    using T = std::remove_cv_t<typename arg_traits<X>::type>;
+    using storage_type =
+        std::conditional_t<std::is_copy_constructible_v<T>, std::optional<T>, bool>;
+
+    void* address(X& x, bool rvalue_param) {
+        if constexpr (arg_traits<X>::is_lvalue) {
+            if (rvalue_param) {
+                if constexpr (std::is_copy_constructible_v<T>) {
+                    return std::addressof(
+                        value.emplace(static_cast<typename arg_traits<X>::type&>(x)));
+                } else {
+                    throw std::runtime_error(
+                        "signature mismatch: an lvalue to an rvalue reference, not "
+                        "copyable");
+                }
+            }
+        }
+        (void)rvalue_param;
+        return arg_address(x);
+    }
+
+    storage_type value{};
 };
 
+}  // namespace detail
+
+//!
+//! bind a callable into ccl2::function<R>, R and the parameter types are taken from
+//! the callable or from `Signature`.
+//!
 struct bind_t {
     template <typename Signature, typename Fn,
               typename = hana::when<!std::is_member_function_pointer<Fn>::value>>
     constexpr decltype(auto) operator()(Fn&& fn, std::true_type = {}) const {
-        using Args = ct::args_t<Signature, hana::tuple>;
+        using Args = ct::args_t<Signature, std::tuple>;
         using Ret  = ct::return_type_t<Signature>;
-
-        // mutable for functor
-        auto newf = [fn = std::move(fn)](void* args, void* result) mutable {
-            auto args_tuple = static_cast<Args*>(args);
-            if constexpr (std::is_void_v<Ret>) {
-                hana::unpack(*args_tuple, std::move(fn));
-            } else {
-                *(Ret*)result = hana::unpack(*args_tuple, std::move(fn));
-            }
-        };
-        return function<Ret>(std::move(newf));
+        return detail::erased<Ret, Args>::wrap(std::forward<Fn>(fn));
     }
 
     template <typename Fn,
               typename = hana::when<!std::is_member_function_pointer<Fn>::value>>
     constexpr decltype(auto) operator()(Fn&& fn, std::false_type = {}) const {
-        using Args = ct::args_t<Fn, hana::tuple>;
+        using Args = ct::args_t<Fn, std::tuple>;
         using Ret  = ct::return_type_t<Fn>;
-
-        // mutable for functor
-        auto newf = [fn = std::move(fn)](void* args, void* result) mutable {
-            auto args_tuple = static_cast<Args*>(args);
-            if constexpr (std::is_void_v<Ret>) {
-                hana::unpack(*args_tuple, std::move(fn));
-            } else {
-                *(Ret*)result = hana::unpack(*args_tuple, std::move(fn));
-            }
-        };
-        return function<Ret>(std::move(newf));
+        return detail::erased<Ret, Args>::wrap(std::forward<Fn>(fn));
     }
 
     template <typename Fn, typename Self,
               typename = hana::when<std::is_member_function_pointer<Fn>::value>>
     constexpr decltype(auto) operator()(const Fn& fn, Self self) const {
         using Ret        = ct::return_type_t<Fn>;
-        using ArgsOrigin = ct::args_t<Fn, hana::tuple>;
+        using ArgsOrigin = ct::args_t<Fn, std::tuple>;
         using Args       = typename detail::tuple_pop_front<ArgsOrigin>::type;
 
         if (self == nullptr) {
@@ -135,32 +512,103 @@ struct bind_t {
                 return (origin->*fn)(std::forward<decltype(args)>(args)...);
             }
         };
-        auto newf = [f](void* args, void* result) {
-            auto args_tuple = static_cast<Args*>(args);
-            if constexpr (std::is_void_v<Ret>) {
-                hana::unpack(*args_tuple, std::move(f));
-            } else {
-                *(Ret*)result = hana::unpack(*args_tuple, std::move(f));
-            }
-        };
-        return function<Ret>(std::move(newf));
+        return detail::erased<Ret, Args>::wrap(std::move(f));
     }
 };
 
 [[maybe_unused]] constexpr bind_t bind{};
 
-//! invoke function<Ret, ArgsTuple> with Args...
+//!
+//! invoke function<R> with Args..., which are passed by reference and never copied.
+//! The result is constructed in place, R needs not be default constructible.
+//!
+//! Throws std::runtime_error if Args... do not match the parameters the function was
+//! bound with, compared after removing references and cv-qualifiers (skipped if
+//! CCL2_CHECKED_DISPATCH is 0), or if a const argument is passed to a non-const
+//! lvalue reference. An lvalue passed to an rvalue reference parameter is copied, the
+//! callee moves from the copy.
+//! Throws std::bad_function_call if `f` is empty and R is not void.
+//!
 struct invoker_t {
-    template <typename R, typename... Args>
-    R operator()(const function<R>& f, Args&&... args) const {
-        auto args_tuple = hana::make_tuple(std::forward<Args>(args)...);
-        // TODO: check Xs is_assignable by decltype(args_tupe)
+    template <typename R, size_t N, typename... Args>
+    R operator()(const function<R, N>& f, Args&&... args) const {
+#if CCL2_CHECKED_DISPATCH
+        using Signature = detail::signature_t<detail::arg_t<Args>...>;
+        if (!f.template accepts<Signature>()) {
+            throw std::runtime_error(std::string("signature mismatch, expect: ")
+                                     + f.signature()->name()
+                                     + ", got: " + typeid(Signature).name());
+        }
+#endif
+        return call(f, detail::pass_arg(std::forward<Args>(args))...);
+    }
+
+    /// `f` is known to be bound with `Signature`, e.g. through a typed topic. Args...
+    /// are converted to its parameters at compile time and not checked at runtime.
+    template <typename Signature, typename R, size_t N, typename... Args>
+    R operator()(with_signature_t<Signature>, const function<R, N>& f,
+                 Args&&... args) const {
+        using Params = ct::args_t<Signature, std::tuple>;
+        return typed(static_cast<Params*>(nullptr), f, std::forward<Args>(args)...);
+    }
+
+private:
+    template <typename... Ps, typename R, size_t N, typename... Args>
+    static R typed(std::tuple<Ps...>*, const function<R, N>& f, Args&&... args) {
+        static_assert(sizeof...(Ps) == sizeof...(Args),
+                      "Expect: the number of arguments of the signature");
+        return call(f, detail::convert_arg<Ps>(std::forward<Args>(args))...);
+    }
+
+    template <typename R, size_t N, typename... Args>
+    static R call(const function<R, N>& f, Args&&... args) {
+        if constexpr (!std::is_void_v<R>) {
+            if (!f) {
+                throw std::bad_function_call();
+            }
+        }
+        constexpr uint64_t consts =
+            detail::param_refs<>::mask({detail::arg_traits<Args>::is_const...});
+        if constexpr (consts != 0) {
+            if ((f.mutable_refs() & consts) != 0) {
+                throw std::runtime_error(
+                    "signature mismatch: a const argument to a non-const reference");
+            }
+        }
+        constexpr uint64_t lvalues =
+            detail::param_refs<>::mask({detail::arg_traits<Args>::is_lvalue...});
+        if constexpr (lvalues != 0) {
+            if ((f.rvalue_refs() & lvalues) != 0) {
+                return call_copied(f, std::index_sequence_for<Args...>{},
+                                   std::forward<Args>(args)...);
+            }
+        }
+        std::array<void*, sizeof...(Args)> argv{detail::arg_address(args)...};
+        return call_argv(f, argv.data());
+    }
+
+    // some lvalues go to rvalue reference parameters, they are copied first
+    template <typename R, size_t N, size_t... I, typename... Args>
+    static R call_copied(const function<R, N>& f, std::index_sequence<I...>,
+                         Args&&... args) {
+        uint64_t copied = f.rvalue_refs();
+        std::tuple<detail::arg_copy<Args>...> copies;
+        std::array<void*, sizeof...(Args)> argv{
+            std::get<I>(copies).address(args, (copied >> I) & 1)...};
+        return call_argv(f, argv.data());
+    }
+
+    template <typename R, size_t N>
+    static R call_argv(const function<R, N>& f, void** argv) {
         if constexpr (std::is_void_v<R>) {
-            f(&args_tuple, nullptr);
+            f(argv, nullptr);
         } else {
-            R result{};
-            f(&args_tuple, &result);
-            return result;
+            result_slot<R> result;
+            f(argv, &result);
+            if (!result.constructed) {
+                throw std::runtime_error("Expect: a result, got none");
+            }
+            return std::move(*result.get());
         }
     }
 };
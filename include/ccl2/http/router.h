@@ -49,6 +49,7 @@ public:
     static response_type not_found(const request_type& r);
     static response_type server_error(const request_type& r, std::string_view what);
     static response_type bad_request(const request_type& r, std::string_view why);
+    static response_type service_unavailable(const request_type& r);
 
 private:
     struct api_route_t;
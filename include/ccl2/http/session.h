@@ -8,6 +8,7 @@
 #include <string>
 #include <string_view>
 #include <ccl2/http/router.h>
+#include <stddef.h>
 
 namespace boost {
 namespace asio {
@@ -22,11 +23,17 @@ public:
     struct options_t {
         int timeout;
         int body_limit;
+        /// cap of concurrent static file reads, 0 for 16
+        size_t blocking_threads;
+        /// cap of queued static file reads (one per 64 KiB chunk), 0 for unbounded. A
+        /// request beyond gets 503 Service Unavailable, a response already started
+        /// drops its connection.
+        size_t blocking_queue;
     };
 
 public:
     HttpServer(boost::asio::io_context& ioc, std::string_view address,
-               unsigned short port, options_t options = {30, -1});
+               unsigned short port, options_t options = {30, -1, 16, 256});
     ~HttpServer();
 
     /// static file server
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <ccl2/function.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+struct MemoizeOptions {
+    /// how long a result is reused, from the end of the call that computed it
+    std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+    /// the most results kept, the least recently used goes first
+    size_t capacity = 1024;
+};
+
+namespace detail {
+
+template <class Tuple>
+struct tuple_hash {
+    size_t operator()(const Tuple& t) const {
+        return std::apply(
+            [](const auto&... v) {
+                size_t h = 0;
+                // boost::hash_combine
+                ((h ^= std::hash<std::remove_cvref_t<decltype(v)>>{}(v) + 0x9e3779b9
+                       + (h << 6) + (h >> 2)),
+                 ...);
+                return h;
+            },
+            t);
+    }
+};
+
+}  // namespace detail
+
+template <class Signature, class F>
+class Memoized;
+
+//!
+//! A pure function memoized by its arguments, for the hot lookups of a Service.
+//!
+//!     auto lookup = ccl2::memoize(load_permission, {std::chrono::seconds(5), 4096});
+//!     svc.register_handler("/permission", lookup);
+//!     lookup.clear();   // invalidate, the copies share the cache
+//!
+//! The arguments are hashed with std::hash, they must be hashable and comparable.
+//! Concurrent calls with the same arguments are coalesced, the function runs once and
+//! the others wait for its result, or its exception. Exceptions are not cached.
+//!
+template <class R, class... Params, class F>
+class Memoized<R(Params...), F> {
+    static_assert(!std::is_void_v<R> && !std::is_reference_v<R>,
+                  "Expect: a function returning a value");
+
+    using clock    = std::chrono::steady_clock;
+    using key_type = std::tuple<std::remove_cvref_t<Params>...>;
+
+public:
+    struct metrics_t {
+        /// served from the cache, or by waiting for an identical call in flight
+        uint64_t hits = 0;
+        /// ran the function
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t size        = 0;
+    };
+
+    Memoized(F f, const MemoizeOptions& options)
+      : state_(std::make_shared<state_t>(std::move(f), options)) {}
+
+    R operator()(Params... args) const {
+        auto& s = *state_;
+        key_type key(args...);
+        std::shared_future<R> cached;
+        // allocates, only on a miss
+        std::optional<std::promise<R>> promise;
+        uint64_t flight = 0;
+        {
+            std::lock_guard<std::mutex> _lck{s.mtx};
+            auto it = s.index.find(key);
+            if (it == s.index.end()) {
+                it = s.index.emplace(key, slot_t{}).first;
+                s.lru.push_front(&it->first);
+                it->second.pos = s.lru.begin();
+                evict(s);
+            } else {
+                s.lru.splice(s.lru.begin(), s.lru, it->second.pos);
+            }
+
+            auto& slot = it->second;
+            if (slot.ready && clock::now() < slot.expires) {
+                s.metrics.hits++;
+                return slot.value.get();
+            } else if (slot.flight != 0 && !slot.ready) {
+                s.metrics.hits++;
+                cached = slot.value;
+            } else {
+                // new, or expired and computed again in place
+                slot.value  = promise.emplace().get_future().share();
+                slot.ready  = false;
+                slot.flight = flight = ++s.flights;
+                s.metrics.misses++;
+            }
+        }
+        if (cached.valid()) {
+            // in flight, wait for it outside of the lock
+            return cached.get();
+        }
+
+        try {
+            R r = s.f(std::forward<Params>(args)...);
+            promise->set_value(r);
+            settle(s, key, flight, true);
+            return r;
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+            settle(s, key, flight, false);
+            throw;
+        }
+    }
+
+    /// drop the cached results, the calls in flight are not waited for
+    void clear() {
+        std::lock_guard<std::mutex> _lck{state_->mtx};
+        state_->index.clear();
+        state_->lru.clear();
+    }
+
+    metrics_t metrics() const {
+        std::lock_guard<std::mutex> _lck{state_->mtx};
+        auto m = state_->metrics;
+        m.size = state_->index.size();
+        return m;
+    }
+
+private:
+    struct slot_t {
+        std::shared_future<R> value;
+        clock::time_point expires;
+        // the value is set, in flight otherwise
+        bool ready = false;
+        // the call computing the value
+        uint64_t flight = 0;
+        typename std::list<const key_type*>::iterator pos;
+    };
+
+    struct state_t {
+        state_t(F&& f, const MemoizeOptions& options)
+          : f(std::move(f)), options(options) {}
+
+        F f;
+        const MemoizeOptions options;
+
+        std::mutex mtx;
+        std::unordered_map<key_type, slot_t, detail::tuple_hash<key_type>> index;
+        // the most recently used first, points to the keys of `index`
+        std::list<const key_type*> lru;
+        uint64_t flights = 0;
+        metrics_t metrics;
+    };
+
+    // called with the lock held. The slots in flight may go too, their waiters keep
+    // the shared state of the future.
+    static void evict(state_t& s) {
+        while (s.index.size() > std::max<size_t>(s.options.capacity, 1)) {
+            auto* key = s.lru.back();
+            s.lru.pop_back();
+            s.index.erase(*key);
+            s.metrics.evictions++;
+        }
+    }
+
+    static void settle(state_t& s, const key_type& key, uint64_t flight, bool ok) {
+        std::lock_guard<std::mutex> _lck{s.mtx};
+        auto it = s.index.find(key);
+        // evicted, cleared, or computed again since
+        if (it == s.index.end() || it->second.flight != flight) {
+            return;
+        }
+        if (ok) {
+            auto now           = clock::now();
+            it->second.ready   = true;
+            it->second.expires = s.options.ttl < clock::time_point::max() - now
+                                     ? now + s.options.ttl
+                                     : clock::time_point::max();
+        } else {
+            s.lru.erase(it->second.pos);
+            s.index.erase(it);
+        }
+    }
+
+private:
+    std::shared_ptr<state_t> state_;
+};
+
+/// memoize `f` as a function of `Signature`
+template <class Signature, class F>
+Memoized<Signature, std::decay_t<F>> memoize(F&& f, const MemoizeOptions& options = {}) {
+    return {std::forward<F>(f), options};
+}
+
+/// the signature is deduced from `f`, a function object or a function pointer
+template <class F, class = std::enable_if_t<!std::is_function_v<F>>>
+auto memoize(F&& f, const MemoizeOptions& options = {}) {
+    return memoize<ct::function_type_t<std::decay_t<F>>>(std::forward<F>(f), options);
+}
+
+}  // namespace ccl2
@@ -0,0 +1,342 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+//!
+//! Runtime metrics of a thread pool.
+//!
+//! Every worker thread owns a cache-line aligned slot of counters, a handler only
+//! touches the slot of the thread it runs on, so the cost is two clock reads and a
+//! few uncontended atomic adds. Threads that are not workers share one extra slot.
+//!
+class PoolMetrics final : boost::noncopyable {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /// log2 buckets of nanoseconds, the last one catches everything above ~1000s
+    static constexpr size_t kBuckets = 40;
+
+    struct histogram_t {
+        uint64_t count  = 0;
+        double avg_ns   = 0;
+        uint64_t p50_ns = 0;
+        uint64_t p90_ns = 0;
+        uint64_t p99_ns = 0;
+        uint64_t max_ns = 0;
+    };
+
+    struct thread_snapshot_t {
+        /// false if the worker exited
+        bool active       = false;
+        uint64_t handlers = 0;
+        uint64_t busy_ns  = 0;
+        /// busy time / wall time since the thread started
+        double utilization = 0;
+        /// elapsed time of the running handler, 0 if idle. A large value means the
+        /// worker is blocked.
+        uint64_t running_ns = 0;
+    };
+
+    struct snapshot_t {
+        uint64_t handlers = 0;
+        /// submitted but not yet run
+        uint64_t queued = 0;
+        /// handler run time
+        histogram_t run_time;
+        /// time from post to run
+        histogram_t delay;
+        std::vector<thread_snapshot_t> threads;
+    };
+
+    /// @param threads: the number of worker slots
+    /// @param timing: measure the run time and delay, otherwise only count handlers
+    explicit PoolMetrics(size_t threads = 0, bool timing = true) : timing_(timing) {
+        resize(threads);
+    }
+
+    inline bool timing() const { return timing_; }
+
+    /// make sure there are at least `threads` worker slots
+    void resize(size_t threads) {
+        std::lock_guard _lck{slots_mtx_};
+        while (slots_.size() < threads) {
+            slots_.emplace_back();
+        }
+    }
+
+    /// called by worker `index` before it runs handlers
+    void bind_thread(size_t index) {
+        slot_t* s;
+        {
+            std::lock_guard _lck{slots_mtx_};
+            s = &slots_.at(index);
+        }
+        // the slot may be reused by a new worker, the busy time is per thread
+        s->busy_ns.store(0, std::memory_order_relaxed);
+        s->started_at.store(now_ns(), std::memory_order_relaxed);
+        current() = binding_t{this, s};
+    }
+
+    void unbind_thread() {
+        auto& b = current();
+        if (b.owner == this) {
+            b.slot->started_at.store(0, std::memory_order_relaxed);
+            b = binding_t{};
+        }
+    }
+
+    /// wrap a handler to record its queueing delay and run time
+    template <class F>
+    auto wrap(F&& f) {
+        local_slot().submitted.fetch_add(1, std::memory_order_relaxed);
+        return [this, posted = timing_ ? now_ns() : 0, f = std::forward<F>(f)]() mutable {
+            if (!timing_) {
+                struct guard_t {
+                    slot_t& s;
+                    ~guard_t() { s.handlers.fetch_add(1, std::memory_order_relaxed); }
+                } guard{local_slot()};
+                f();
+                return;
+            }
+
+            auto& s       = local_slot();
+            int64_t start = now_ns();
+            record(s.delay, start - posted);
+
+            // handlers dispatched inline are counted but their time is not doubled
+            int64_t outer = s.running_since.load(std::memory_order_relaxed);
+            if (outer == 0) {
+                s.running_since.store(start, std::memory_order_relaxed);
+            }
+
+            struct guard_t {
+                slot_t& s;
+                int64_t start;
+                int64_t outer;
+                ~guard_t() {
+                    int64_t elapsed = now_ns() - start;
+                    s.handlers.fetch_add(1, std::memory_order_relaxed);
+                    record(s.run_time, elapsed);
+                    if (outer == 0) {
+                        s.running_since.store(0, std::memory_order_relaxed);
+                        s.busy_ns.fetch_add(elapsed, std::memory_order_relaxed);
+                    }
+                }
+            } guard{s, start, outer};
+            f();
+        };
+    }
+
+    snapshot_t snapshot() const {
+        snapshot_t r;
+        std::array<uint64_t, kBuckets> run{}, delay{};
+        uint64_t run_sum = 0, delay_sum = 0, submitted = 0;
+        int64_t now = now_ns();
+
+        std::lock_guard _lck{slots_mtx_};
+        auto merge = [&](const slot_t& s) {
+            submitted += s.submitted.load(std::memory_order_relaxed);
+            r.handlers += s.handlers.load(std::memory_order_relaxed);
+            run_sum += s.run_time.sum.load(std::memory_order_relaxed);
+            delay_sum += s.delay.sum.load(std::memory_order_relaxed);
+            r.run_time.max_ns = std::max(r.run_time.max_ns,
+                                         s.run_time.max.load(std::memory_order_relaxed));
+            r.delay.max_ns    = std::max(r.delay.max_ns,
+                                      s.delay.max.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < kBuckets; i++) {
+                run[i] += s.run_time.buckets[i].load(std::memory_order_relaxed);
+                delay[i] += s.delay.buckets[i].load(std::memory_order_relaxed);
+            }
+        };
+
+        merge(external_);
+        for (const auto& s : slots_) {
+            merge(s);
+
+            thread_snapshot_t t;
+            t.handlers      = s.handlers.load(std::memory_order_relaxed);
+            t.busy_ns       = s.busy_ns.load(std::memory_order_relaxed);
+            int64_t started = s.started_at.load(std::memory_order_relaxed);
+            t.active        = started > 0;
+            if (started > 0 && now > started) {
+                t.utilization = std::min(1.0, double(t.busy_ns) / double(now - started));
+            }
+            int64_t since = s.running_since.load(std::memory_order_relaxed);
+            t.running_ns  = since > 0 && now > since ? uint64_t(now - since) : 0;
+            r.threads.emplace_back(t);
+        }
+
+        // a handler is counted as submitted before it is counted as run
+        r.queued = submitted > r.handlers ? submitted - r.handlers : 0;
+        fill(r.run_time, run, run_sum);
+        fill(r.delay, delay, delay_sum);
+        return r;
+    }
+
+private:
+    struct series_t {
+        std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<uint64_t> max{0};
+    };
+
+    struct alignas(64) slot_t {
+        std::atomic<uint64_t> submitted{0};
+        std::atomic<uint64_t> handlers{0};
+        std::atomic<uint64_t> busy_ns{0};
+        std::atomic<int64_t> running_since{0};
+        std::atomic<int64_t> started_at{0};
+        series_t run_time;
+        series_t delay;
+    };
+
+    struct binding_t {
+        const PoolMetrics* owner = nullptr;
+        slot_t* slot             = nullptr;
+    };
+
+    static binding_t& current() {
+        static thread_local binding_t b;
+        return b;
+    }
+
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clock::now().time_since_epoch())
+            .count();
+    }
+
+    // floor(log2(ns))
+    static size_t bucket_of(uint64_t ns) {
+#if defined(__GNUC__) || defined(__clang__)
+        size_t i = ns > 1 ? size_t(63 - __builtin_clzll(ns)) : 0;
+#else
+        size_t i = 0;
+        while (ns > 1) {
+            ns >>= 1;
+            i++;
+        }
+#endif
+        return std::min(i, kBuckets - 1);
+    }
+
+    slot_t& local_slot() {
+        auto& b = current();
+        return b.owner == this ? *b.slot : external_;
+    }
+
+    static void record(series_t& s, int64_t ns) {
+        uint64_t v = ns > 0 ? uint64_t(ns) : 0;
+        s.buckets[bucket_of(v)].fetch_add(1, std::memory_order_relaxed);
+        s.sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t m = s.max.load(std::memory_order_relaxed);
+        while (v > m && !s.max.compare_exchange_weak(m, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    static void fill(histogram_t& h, const std::array<uint64_t, kBuckets>& buckets,
+                     uint64_t sum) {
+        for (auto c : buckets) {
+            h.count += c;
+        }
+        if (h.count == 0) {
+            return;
+        }
+        h.avg_ns = double(sum) / double(h.count);
+
+        // the upper bound of the bucket, but never above the max seen
+        auto percentile = [&](double p) -> uint64_t {
+            uint64_t rank = uint64_t(p * double(h.count - 1)) + 1;
+            uint64_t acc  = 0;
+            for (size_t i = 0; i < kBuckets; i++) {
+                acc += buckets[i];
+                if (acc >= rank) {
+                    return std::min(uint64_t(1) << (i + 1), h.max_ns);
+                }
+            }
+            return h.max_ns;
+        };
+        h.p50_ns = percentile(0.50);
+        h.p90_ns = percentile(0.90);
+        h.p99_ns = percentile(0.99);
+    }
+
+private:
+    const bool timing_;
+    mutable std::mutex slots_mtx_;
+    // std::deque keeps the slots in place while growing
+    std::deque<slot_t> slots_;
+    slot_t external_;
+};
+
+//!
+//! Executor adapter which records every handler it runs into PoolMetrics.
+//!
+//! I/O objects and coroutines created on it are measured too, all the properties
+//! are forwarded to the inner executor.
+//!
+template <class Inner>
+class instrumented_executor {
+public:
+    instrumented_executor(const Inner& inner, PoolMetrics* metrics) noexcept
+      : inner_(inner), metrics_(metrics) {}
+
+    const Inner& inner() const noexcept { return inner_; }
+
+    template <class Property>
+    auto query(const Property& p) const
+        -> decltype(boost::asio::query(std::declval<const Inner&>(), p)) {
+        return boost::asio::query(inner_, p);
+    }
+
+    template <class Property>
+    auto require(const Property& p) const -> instrumented_executor<std::decay_t<
+        decltype(boost::asio::require(std::declval<const Inner&>(), p))>> {
+        return {boost::asio::require(inner_, p), metrics_};
+    }
+
+    template <class Property>
+    auto prefer(const Property& p) const -> instrumented_executor<
+        std::decay_t<decltype(boost::asio::prefer(std::declval<const Inner&>(), p))>> {
+        return {boost::asio::prefer(inner_, p), metrics_};
+    }
+
+    template <class F>
+    void execute(F&& f) const {
+        if (metrics_) {
+            boost::asio::execution::execute(inner_, metrics_->wrap(std::forward<F>(f)));
+        } else {
+            boost::asio::execution::execute(inner_, std::forward<F>(f));
+        }
+    }
+
+    friend bool operator==(const instrumented_executor& a,
+                           const instrumented_executor& b) noexcept {
+        return a.inner_ == b.inner_ && a.metrics_ == b.metrics_;
+    }
+
+    friend bool operator!=(const instrumented_executor& a,
+                           const instrumented_executor& b) noexcept {
+        return !(a == b);
+    }
+
+private:
+    Inner inner_;
+    PoolMetrics* metrics_;
+};
+
+}  // namespace ccl2
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <boost/core/noncopyable.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+namespace detail {
+
+//!
+//! Epoch based reclamation, shared by all the RcuMutex.
+//!
+//! A reader announces the epoch it entered in, in a cache-line aligned slot owned by
+//! its thread: one load and one store, no waiting, no shared cache line written.
+//! A writer publishes the new version, then advances the epoch, the old version is
+//! freed once every reader in the slots entered at the new epoch or later.
+//!
+class rcu_domain final : boost::noncopyable {
+    struct alignas(64) slot_t {
+        // 0: not in a read section
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> owned{true};
+        slot_t* next = nullptr;
+        // nesting, only touched by the owner
+        size_t depth = 0;
+    };
+
+    struct local_t {
+        explicit local_t(rcu_domain& d) : slot(d.acquire()) {}
+        ~local_t() { slot->owned.store(false, std::memory_order_release); }
+        slot_t* slot;
+    };
+
+public:
+    // never destroyed, the slots may be released by threads exiting after main()
+    static rcu_domain& get() {
+        static auto* d = new rcu_domain;
+        return *d;
+    }
+
+    void enter() noexcept {
+        auto* s = local();
+        if (s->depth++ == 0) {
+            s->epoch.store(epoch_.load(std::memory_order_seq_cst),
+                           std::memory_order_seq_cst);
+        }
+    }
+
+    void exit() noexcept {
+        auto* s = local();
+        if (--s->depth == 0) {
+            s->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    /// called after a new version is published, the old one is safe to free once
+    /// `oldest()` reaches the returned epoch
+    uint64_t advance() noexcept {
+        return epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    }
+
+    /// the epoch of the oldest reader, UINT64_MAX if there is none
+    uint64_t oldest() const noexcept {
+        uint64_t r = UINT64_MAX;
+        for (auto* s = head_.load(std::memory_order_acquire); s; s = s->next) {
+            uint64_t e = s->epoch.load(std::memory_order_seq_cst);
+            if (e != 0) {
+                r = std::min(r, e);
+            }
+        }
+        return r;
+    }
+
+private:
+    rcu_domain() = default;
+
+    slot_t* local() {
+        static thread_local local_t l(*this);
+        return l.slot;
+    }
+
+    // slots are reused by new threads, and never freed
+    slot_t* acquire() {
+        for (auto* s = head_.load(std::memory_order_acquire); s; s = s->next) {
+            bool owned = false;
+            if (!s->owned.load(std::memory_order_relaxed)
+                && s->owned.compare_exchange_strong(owned, true,
+                                                    std::memory_order_acquire)) {
+                return s;
+            }
+        }
+        auto* s = new slot_t;
+        s->next = head_.load(std::memory_order_relaxed);
+        while (!head_.compare_exchange_weak(s->next, s, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+        }
+        return s;
+    }
+
+private:
+    std::atomic<uint64_t> epoch_{1};
+    std::atomic<slot_t*> head_{nullptr};
+};
+
+}  // namespace detail
+
+//!
+//! Mutex policy of read-mostly data, a read-copy-update lock.
+//!
+//! `lock_shared()` never waits and never writes a shared cache line, so readers scale
+//! with cores. Writers are serialized by `lock()`, but they do not exclude readers:
+//! they publish a new copy of the data atomically, and hand the old one to
+//! `retire()`, which frees it once no reader can still see it.
+//!
+//!     std::shared_lock _lck{mtx};      // reader
+//!     auto* d = data.load();
+//!
+//!     std::lock_guard _lck{mtx};       // writer
+//!     auto* old = data.exchange(new T(*data.load()));
+//!     mtx.retire(old);
+//!
+class RcuMutex final : boost::noncopyable {
+public:
+    RcuMutex() : domain_(detail::rcu_domain::get()) {}
+
+    /// no reader may be left
+    ~RcuMutex() {
+        for (auto& r : retired_) {
+            r.free(r.ptr);
+        }
+    }
+
+    inline void lock() { mtx_.lock(); }
+
+    inline bool try_lock() { return mtx_.try_lock(); }
+
+    inline void unlock() { mtx_.unlock(); }
+
+    inline void lock_shared() noexcept { domain_.enter(); }
+
+    inline bool try_lock_shared() noexcept {
+        domain_.enter();
+        return true;
+    }
+
+    inline void unlock_shared() noexcept { domain_.exit(); }
+
+    /// called with the lock held, after the replacement of `p` is published
+    template <class T>
+    void retire(const T* p) {
+        if (p == nullptr) {
+            return;
+        }
+        uint64_t epoch = domain_.advance();
+        retired_.push_back(
+            retired_t{epoch, p, [](const void* q) { delete static_cast<const T*>(q); }});
+        reclaim();
+    }
+
+    /// the number of retired versions not yet freed
+    size_t pending() const {
+        std::lock_guard _lck{mtx_};
+        return retired_.size();
+    }
+
+private:
+    struct retired_t {
+        uint64_t epoch;
+        const void* ptr;
+        void (*free)(const void*);
+    };
+
+    void reclaim() {
+        uint64_t oldest = domain_.oldest();
+        auto it         = std::stable_partition(retired_.begin(), retired_.end(),
+                                        [oldest](const retired_t& r) {
+                                            return r.epoch > oldest;
+                                        });
+        for (auto i = it; i != retired_.end(); ++i) {
+            i->free(i->ptr);
+        }
+        retired_.erase(it, retired_.end());
+    }
+
+private:
+    detail::rcu_domain& domain_;
+    mutable std::mutex mtx_;
+    std::vector<retired_t> retired_;
+};
+
+}  // namespace ccl2
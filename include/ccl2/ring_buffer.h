@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <utility>
+#include <boost/core/noncopyable.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+namespace detail {
+
+//!
+//! Bounded lock-free MPMC ring buffer
+//!     refer: https://www.1024cores.net/home/lock-free-algorithms/queues
+//!            (Bounded MPMC queue, D. Vyukov)
+//!
+//! Each cell carries a sequence number, a push/pop costs one CAS on the shared
+//! position and no allocation.
+//!
+template <class T>
+class ring_buffer : boost::noncopyable {
+    struct cell_t {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* value() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+public:
+    /// @param capacity: rounded up to a power of 2
+    explicit ring_buffer(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        mask_  = cap - 1;
+        cells_ = std::make_unique<cell_t[]>(cap);
+        for (size_t i = 0; i < cap; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        enqueue_pos_.store(0, std::memory_order_relaxed);
+        dequeue_pos_.store(0, std::memory_order_relaxed);
+    }
+
+    ~ring_buffer() {
+        while (try_pop()) {
+        }
+    }
+
+    /// `v` is moved only on success
+    template <class U>
+    bool try_push(U&& v) {
+        cell_t* cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell         = &cells_[pos & mask_];
+            size_t seq   = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos);
+            if (dif == 0) {
+                if (enqueue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;  // full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->storage) T(std::forward<U>(v));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::optional<T> try_pop() {
+        cell_t* cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell         = &cells_[pos & mask_];
+            size_t seq   = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+            if (dif == 0) {
+                if (dequeue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return std::nullopt;  // empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> r(std::move(*cell->value()));
+        cell->value()->~T();
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return r;
+    }
+
+    /// approximate while other threads push/pop
+    size_t size() const {
+        size_t e = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t d = dequeue_pos_.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    size_t mask_;
+    std::unique_ptr<cell_t[]> cells_;
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+//!
+//! Unbounded MPMC storage: a lock-free ring, and an overflow list under a mutex
+//! once the ring is full.
+//!
+//! To keep the FIFO order, once an item spilled all the pushes go to the overflow
+//! list until the consumers drained it, even if the ring has room again. Under a
+//! sustained backlog of more than the ring holds, push and pop both take the mutex
+//! and the queue is no faster than a locked deque, see bench_ring_buffer.cpp. Size
+//! the ring for the expected backlog, or bound the queue (BoundedAsyncQueue).
+//!
+template <class T>
+class spill_queue : boost::noncopyable {
+public:
+    explicit spill_queue(size_t capacity)
+      : ring_(capacity), overflowed_(false), overflow_size_(0) {}
+
+    void push(T&& v) {
+        if (overflowed_.load(std::memory_order_acquire)
+            || !ring_.try_push(std::move(v))) {
+            // keep the FIFO order: once spilled, the following items spill too
+            // until the consumer takes the overflow list
+            std::lock_guard _lck{overflow_mtx_};
+            overflow_.emplace_back(std::move(v));
+            overflow_size_.store(overflow_.size(), std::memory_order_relaxed);
+            overflowed_.store(true, std::memory_order_release);
+        }
+    }
+
+    std::optional<T> try_pop() {
+        if (auto v = ring_.try_pop()) {
+            return v;
+        }
+
+        std::optional<T> r;
+        if (overflowed_.load(std::memory_order_acquire)) {
+            std::lock_guard _lck{overflow_mtx_};
+            if (!overflow_.empty()) {
+                r.emplace(std::move(overflow_.front()));
+                overflow_.pop_front();
+                overflow_size_.store(overflow_.size(), std::memory_order_relaxed);
+            }
+            if (overflow_.empty()) {
+                overflowed_.store(false, std::memory_order_release);
+            }
+        }
+        return r;
+    }
+
+    /// move at most `max` items to the back of `r`
+    /// @return: the number of items moved
+    template <class Container>
+    size_t take(Container& r, size_t max) {
+        size_t n = 0;
+        for (; n < max; n++) {
+            auto v = ring_.try_pop();
+            if (!v) {
+                break;
+            }
+            r.emplace_back(std::move(*v));
+        }
+
+        // the ring is drained, the overflow list holds the newer items
+        if (n < max && overflowed_.load(std::memory_order_acquire)) {
+            std::lock_guard _lck{overflow_mtx_};
+            while (n < max && !overflow_.empty()) {
+                r.emplace_back(std::move(overflow_.front()));
+                overflow_.pop_front();
+                n++;
+            }
+            overflow_size_.store(overflow_.size(), std::memory_order_relaxed);
+            if (overflow_.empty()) {
+                overflowed_.store(false, std::memory_order_release);
+            }
+        }
+        return n;
+    }
+
+    size_t size() const {
+        return ring_.size() + overflow_size_.load(std::memory_order_relaxed);
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    ring_buffer<T> ring_;
+
+    std::atomic<bool> overflowed_;
+    std::atomic<size_t> overflow_size_;
+    std::mutex overflow_mtx_;
+    std::deque<T> overflow_;
+};
+
+}  // namespace detail
+
+}  // namespace ccl2
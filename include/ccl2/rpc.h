@@ -0,0 +1,6 @@
+#pragma once
+
+#include <ccl2/rpc/client.h>
+#include <ccl2/rpc/codec.h>
+#include <ccl2/rpc/frame.h>
+#include <ccl2/rpc/server.h>
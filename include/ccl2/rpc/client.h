@@ -0,0 +1,202 @@
+#pragma once
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/async_queue.h>
+#include <ccl2/function.h>
+#include <ccl2/rpc/codec.h>
+#include <ccl2/rpc/frame.h>
+#include <ccl2/service.h>
+#include <ccl2/topic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+namespace rpc {
+
+//!
+//! Call the services of a remote rpc::Server, over one connection.
+//!
+//!     ccl2::rpc::Client<asio::local::stream_protocol> client(ioc.get_executor());
+//!     co_await client.connect({"/tmp/svc.sock"});
+//!     int r = co_await client.call(kAdd, 3, 4);
+//!     int s = co_await client.call<int>("/add", 3, 4);
+//!
+//! Calls are pipelined: any number of them may be in flight at the same time, from any
+//! thread, and each completes when its own response arrives. The exception thrown by
+//! the remote handler is rethrown as std::runtime_error. When the connection is lost
+//! all the calls in flight fail with "connection closed".
+//!
+//! The calls in flight are not limited here, the caller bounds them. While the server
+//! pushes back (see Server::options_t) their requests queue in memory.
+//!
+template <class Protocol, class Executor = boost::asio::any_io_executor>
+class Client : boost::noncopyable {
+    using strand_type = boost::asio::strand<Executor>;
+    using socket_type =
+        typename Protocol::socket::template rebind_executor<strand_type>::other;
+
+    template <class... Args>
+    using wire_tuple_t = std::tuple<detail::wire_t<Args>...>;
+
+    template <class R>
+    using result_t =
+        typename std::conditional_t<std::is_void_v<R>, std::common_type<void>,
+                                    detail::wire<std::decay_t<R>>>::type;
+
+public:
+    struct options_t {
+        /// the largest frame accepted, the connection is closed beyond
+        size_t max_frame = 16 * 1024 * 1024;
+    };
+
+    explicit Client(const Executor& ex, options_t options = {})
+      : conn_(std::make_shared<conn_t>(socket_type(boost::asio::make_strand(ex)),
+                                       options.max_frame)) {}
+
+    ~Client() { close(); }
+
+    boost::asio::awaitable<void> connect(const typename Protocol::endpoint& endpoint) {
+        co_await conn_->ch->stream().async_connect(endpoint, boost::asio::use_awaitable);
+        boost::asio::co_spawn(conn_->ch->stream().get_executor(), read_loop(conn_),
+                              boost::asio::detached);
+    }
+
+    /// fail the calls in flight, and those to come
+    void close() {
+        boost::asio::post(conn_->ch->stream().get_executor(), [conn = conn_] {
+            conn->ch->close();
+            conn->fail_all();
+        });
+    }
+
+    /// unchecked, `Args...` must match the parameters of the remote handler
+    template <class R, class... Args>
+    boost::asio::awaitable<R> call(std::string_view svc, const Args&... args) {
+        std::string payload;
+        rpc::encode(payload, svc);
+        (rpc::encode(payload, args), ...);
+        auto result = co_await request(std::move(payload));
+        if constexpr (std::is_void_v<R>) {
+            detail::expect(result.empty(), "Expect: eof, got trailing bytes");
+        } else {
+            co_return rpc::decode<R>(result);
+        }
+    }
+
+    /// `Args...` are converted to the parameters of `Signature`
+    template <class Signature, class... Args,
+              class R = result_t<ccl2::detail::awaited_t<ct::return_type_t<Signature>>>>
+    boost::asio::awaitable<R> call(const Topic<Signature>& svc, Args&&... args) {
+        using Params = ct::args_t<Signature, wire_tuple_t>;
+        static_assert(std::tuple_size_v<Params> == sizeof...(Args),
+                      "Expect: as many arguments as the signature");
+
+        std::string payload;
+        Params params(std::forward<Args>(args)...);
+        rpc::encode(payload, svc.name());
+        rpc::encode(payload, params);
+        auto result = co_await request(std::move(payload));
+        if constexpr (std::is_void_v<R>) {
+            detail::expect(result.empty(), "Expect: eof, got trailing bytes");
+        } else {
+            co_return rpc::decode<R>(result);
+        }
+    }
+
+private:
+    using waiter_type = ccl2::detail::async_waiter<std::exception_ptr, std::string>;
+
+    // shared with the reader, only touched on the strand of the socket
+    struct conn_t {
+        conn_t(socket_type&& socket, size_t max_frame)
+          : ch(std::make_shared<detail::channel<socket_type>>(std::move(socket),
+                                                              max_frame)) {}
+
+        void start(std::string&& payload, waiter_type&& waiter) {
+            if (!connected || ch->closed()) {
+                waiter.complete(std::make_exception_ptr(std::runtime_error(
+                                    connected ? "connection closed" : "not connected")),
+                                std::string());
+                return;
+            }
+            uint64_t id = ++next_id;
+            pending.emplace(id, std::move(waiter));
+            auto& out = ch->out();
+            auto pos  = detail::begin_frame(out, id, frame_type::request);
+            out.append(payload);
+            detail::end_frame(out, pos);
+            ch->send();
+        }
+
+        void fail_all() {
+            auto calls = std::move(pending);
+            pending.clear();
+            for (auto& [id, waiter] : calls) {
+                waiter.complete(
+                    std::make_exception_ptr(std::runtime_error("connection closed")),
+                    std::string());
+            }
+        }
+
+        std::shared_ptr<detail::channel<socket_type>> ch;
+        std::unordered_map<uint64_t, waiter_type> pending;
+        uint64_t next_id = 0;
+        bool connected   = false;
+    };
+
+    // resumes on the executor of the calling coroutine
+    boost::asio::awaitable<std::string> request(std::string payload) {
+        return boost::asio::async_initiate<decltype(boost::asio::use_awaitable),
+                                           void(std::exception_ptr, std::string)>(
+            [conn = conn_](auto handler, std::string payload) {
+                boost::asio::post(conn->ch->stream().get_executor(),
+                                  [conn, payload = std::move(payload),
+                                   waiter = waiter_type(std::move(handler))]() mutable {
+                                      conn->start(std::move(payload), std::move(waiter));
+                                  });
+            },
+            boost::asio::use_awaitable, std::move(payload));
+    }
+
+    static boost::asio::awaitable<void> read_loop(std::shared_ptr<conn_t> conn) {
+        conn->connected = true;
+        frame_t f;
+        while (co_await conn->ch->read(f)) {
+            auto it = conn->pending.find(f.id);
+            if (it == conn->pending.end() || f.type == frame_type::request) {
+                conn->ch->close();
+                break;
+            }
+            auto waiter = std::move(it->second);
+            conn->pending.erase(it);
+            if (f.type == frame_type::response) {
+                waiter.complete(nullptr, std::string(f.payload));
+            } else {
+                std::string msg = "bad error frame";
+                try {
+                    msg = rpc::decode<std::string>(f.payload);
+                } catch (const std::exception&) {
+                }
+                waiter.complete(std::make_exception_ptr(std::runtime_error(msg)),
+                                std::string());
+            }
+        }
+        conn->fail_all();
+    }
+
+private:
+    std::shared_ptr<conn_t> conn_;
+};
+
+}  // namespace rpc
+}  // namespace ccl2
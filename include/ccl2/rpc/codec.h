@@ -0,0 +1,308 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/hana.hpp>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace hana = boost::hana;
+
+namespace ccl2 {
+namespace rpc {
+
+//
+// Compact binary encoding of the arguments and results of a remote call.
+//
+// Fixed width little-endian numbers, sizes as LEB128 varints, no field names nor
+// tags: both ends know the types from the signature of the service.
+//
+namespace detail {
+
+inline void expect(bool ok, const char* msg) {
+    if (!ok) {
+        throw std::runtime_error(msg);
+    }
+}
+
+inline void encode_size(std::string& out, uint64_t n) {
+    while (n >= 0x80) {
+        out.push_back(char(uint8_t(n) | 0x80));
+        n >>= 7;
+    }
+    out.push_back(char(n));
+}
+
+inline uint64_t decode_size(std::string_view& in) {
+    uint64_t n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        expect(!in.empty(), "Expect: a varint, got eof");
+        auto b = uint8_t(in.front());
+        in.remove_prefix(1);
+        n |= uint64_t(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) {
+            return n;
+        }
+    }
+    throw std::runtime_error("Expect: a varint of at most 10 bytes");
+}
+
+inline std::string_view take(std::string_view& in, uint64_t n) {
+    expect(in.size() >= n, "Expect: more bytes, got eof");
+    auto r = in.substr(0, n);
+    in.remove_prefix(n);
+    return r;
+}
+
+template <size_t N>
+struct uint_of;
+
+template <>
+struct uint_of<1> {
+    using type = uint8_t;
+};
+
+template <>
+struct uint_of<2> {
+    using type = uint16_t;
+};
+
+template <>
+struct uint_of<4> {
+    using type = uint32_t;
+};
+
+template <>
+struct uint_of<8> {
+    using type = uint64_t;
+};
+
+// reflection types, see BOOST_HANA_DEFINE_STRUCT
+template <class T, class = void>
+struct binary_convert {
+    static_assert(hana::Struct<T>::value, "T expect be a reflection type");
+
+    static void encode(std::string& out, const T& rhs) {
+        hana::for_each(hana::members(rhs), [&](const auto& member) {
+            using Member = std::remove_cv_t<std::remove_reference_t<decltype(member)>>;
+            binary_convert<Member>::encode(out, member);
+        });
+    }
+
+    static void decode(std::string_view& in, T& rhs) {
+        hana::for_each(hana::keys(rhs), [&](const auto& key) {
+            auto& member = hana::at_key(rhs, key);
+            using Member = std::remove_reference_t<decltype(member)>;
+            binary_convert<Member>::decode(in, member);
+        });
+    }
+};
+
+// bool, integers, floating points and enums
+template <class T>
+struct binary_convert<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T>>> {
+    using U = typename uint_of<sizeof(T)>::type;
+
+    static void encode(std::string& out, const T& rhs) {
+        U u;
+        memcpy(&u, &rhs, sizeof(T));
+        for (size_t i = 0; i < sizeof(T); i++) {
+            out.push_back(char(uint8_t(u >> (8 * i))));
+        }
+    }
+
+    static void decode(std::string_view& in, T& rhs) {
+        auto bytes = take(in, sizeof(T));
+        U u        = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            u |= U(uint8_t(bytes[i])) << (8 * i);
+        }
+        if constexpr (std::is_same_v<T, bool>) {
+            rhs = u != 0;
+        } else {
+            memcpy(&rhs, &u, sizeof(T));
+        }
+    }
+};
+
+// std::string, encoded only: std::string_view, const char*
+template <>
+struct binary_convert<std::string> {
+    static void encode(std::string& out, std::string_view rhs) {
+        encode_size(out, rhs.size());
+        out.append(rhs);
+    }
+
+    static void decode(std::string_view& in, std::string& rhs) {
+        rhs = take(in, decode_size(in));
+    }
+};
+
+template <>
+struct binary_convert<std::string_view> {
+    static void encode(std::string& out, std::string_view rhs) {
+        binary_convert<std::string>::encode(out, rhs);
+    }
+};
+
+template <>
+struct binary_convert<const char*> {
+    static void encode(std::string& out, std::string_view rhs) {
+        binary_convert<std::string>::encode(out, rhs);
+    }
+};
+
+template <>
+struct binary_convert<char*> : binary_convert<const char*> {};
+
+// std::vector
+template <class T, class A>
+struct binary_convert<std::vector<T, A>> {
+    static void encode(std::string& out, const std::vector<T, A>& rhs) {
+        encode_size(out, rhs.size());
+        for (const auto& v : rhs) {
+            binary_convert<T>::encode(out, v);
+        }
+    }
+
+    static void decode(std::string_view& in, std::vector<T, A>& rhs) {
+        auto n = decode_size(in);
+        // every element takes a byte at least, do not trust `n` further
+        expect(n <= in.size(), "Expect: more bytes, got eof");
+        rhs.clear();
+        rhs.reserve(n);
+        for (uint64_t i = 0; i < n; i++) {
+            binary_convert<T>::decode(in, rhs.emplace_back());
+        }
+    }
+};
+
+// std::map, std::unordered_map
+template <class Map>
+struct binary_convert_map {
+    static void encode(std::string& out, const Map& rhs) {
+        encode_size(out, rhs.size());
+        for (const auto& [k, v] : rhs) {
+            binary_convert<typename Map::key_type>::encode(out, k);
+            binary_convert<typename Map::mapped_type>::encode(out, v);
+        }
+    }
+
+    static void decode(std::string_view& in, Map& rhs) {
+        auto n = decode_size(in);
+        expect(n <= in.size(), "Expect: more bytes, got eof");
+        rhs.clear();
+        for (uint64_t i = 0; i < n; i++) {
+            typename Map::key_type k;
+            typename Map::mapped_type v;
+            binary_convert<typename Map::key_type>::decode(in, k);
+            binary_convert<typename Map::mapped_type>::decode(in, v);
+            rhs.emplace(std::move(k), std::move(v));
+        }
+    }
+};
+
+template <class K, class V, class C, class A>
+struct binary_convert<std::map<K, V, C, A>> : binary_convert_map<std::map<K, V, C, A>> {};
+
+template <class K, class V, class H, class E, class A>
+struct binary_convert<std::unordered_map<K, V, H, E, A>>
+  : binary_convert_map<std::unordered_map<K, V, H, E, A>> {};
+
+// std::optional
+template <class T>
+struct binary_convert<std::optional<T>> {
+    static void encode(std::string& out, const std::optional<T>& rhs) {
+        out.push_back(rhs ? 1 : 0);
+        if (rhs) {
+            binary_convert<T>::encode(out, *rhs);
+        }
+    }
+
+    static void decode(std::string_view& in, std::optional<T>& rhs) {
+        if (take(in, 1)[0] == 0) {
+            rhs.reset();
+        } else {
+            binary_convert<T>::decode(in, rhs.emplace());
+        }
+    }
+};
+
+// std::tuple, std::pair
+template <class... Ts>
+struct binary_convert<std::tuple<Ts...>> {
+    static void encode(std::string& out, const std::tuple<Ts...>& rhs) {
+        std::apply([&](const auto&... v) { (binary_convert<Ts>::encode(out, v), ...); },
+                   rhs);
+    }
+
+    static void decode(std::string_view& in, std::tuple<Ts...>& rhs) {
+        std::apply([&](auto&... v) { (binary_convert<Ts>::decode(in, v), ...); }, rhs);
+    }
+};
+
+template <class A, class B>
+struct binary_convert<std::pair<A, B>> {
+    static void encode(std::string& out, const std::pair<A, B>& rhs) {
+        binary_convert<A>::encode(out, rhs.first);
+        binary_convert<B>::encode(out, rhs.second);
+    }
+
+    static void decode(std::string_view& in, std::pair<A, B>& rhs) {
+        binary_convert<A>::decode(in, rhs.first);
+        binary_convert<B>::decode(in, rhs.second);
+    }
+};
+
+// the decoded type of a parameter
+template <class T>
+struct wire {
+    using type = std::remove_cv_t<std::remove_reference_t<T>>;
+};
+
+template <>
+struct wire<std::string_view> {
+    using type = std::string;
+};
+
+template <>
+struct wire<const char*> {
+    using type = std::string;
+};
+
+template <class T>
+using wire_t = typename wire<std::decay_t<T>>::type;
+
+}  // namespace detail
+
+/// append `v` to `out`
+template <class T>
+void encode(std::string& out, const T& v) {
+    detail::binary_convert<detail::wire_t<T>>::encode(out, v);
+}
+
+/// consume `v` from the front of `in`, throws std::runtime_error if truncated
+template <class T>
+void decode(std::string_view& in, T& v) {
+    detail::binary_convert<T>::decode(in, v);
+}
+
+template <class T>
+T decode(std::string_view in) {
+    T v{};
+    decode(in, v);
+    detail::expect(in.empty(), "Expect: eof, got trailing bytes");
+    return v;
+}
+
+}  // namespace rpc
+}  // namespace ccl2
@@ -0,0 +1,197 @@
+#pragma once
+
+#ifndef CCL2_USE_COROUTINES
+#    error "Please rebuild with CCL2_WITH_COROUTINES"
+#endif
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/rpc/codec.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+namespace rpc {
+
+enum class frame_type : uint8_t {
+    /// payload: the name of the service, then the arguments
+    request = 1,
+    /// payload: the result
+    response = 2,
+    /// payload: the message of the exception thrown by the service
+    error = 3,
+};
+
+struct frame_t {
+    uint64_t id = 0;
+    frame_type type{};
+    std::string_view payload;
+};
+
+namespace detail {
+
+//
+// A frame on the wire:
+//     u32 size | u64 id | u8 type | payload
+// `size` counts the bytes after it. The responses carry the id of their request and
+// may come in any order, so one connection carries many calls at the same time.
+//
+constexpr size_t kFrameSize   = 4;
+constexpr size_t kFrameHeader = kFrameSize + 8 + 1;
+
+/// start a frame at the end of `out`, the payload is appended by the caller
+inline size_t begin_frame(std::string& out, uint64_t id, frame_type type) {
+    size_t pos = out.size();
+    out.append(kFrameSize, '\0');
+    binary_convert<uint64_t>::encode(out, id);
+    binary_convert<uint8_t>::encode(out, uint8_t(type));
+    return pos;
+}
+
+inline void end_frame(std::string& out, size_t pos) {
+    std::string size;
+    binary_convert<uint32_t>::encode(size, uint32_t(out.size() - pos - kFrameSize));
+    out.replace(pos, kFrameSize, size);
+}
+
+//!
+//! A framed stream, shared by the coroutines of one connection.
+//!
+//! All of them run on the executor of the stream, a strand if the io_context has
+//! several threads. Frames queued while a write is in flight go out together in the
+//! next write, a pipelined burst costs one syscall. `out()` is not bounded, the reader
+//! applies backpressure with `buffered()` and `wait()`.
+//!
+template <class Stream>
+class channel : boost::noncopyable, public std::enable_shared_from_this<channel<Stream>> {
+public:
+    channel(Stream&& stream, size_t max_frame)
+      : stream_(std::move(stream)),
+        max_frame_(max_frame),
+        wake_(stream_.get_executor()) {}
+
+    Stream& stream() noexcept { return stream_; }
+
+    /// false on eof or error. `f.payload` is valid until the next read.
+    boost::asio::awaitable<bool> read(frame_t& f) {
+        for (;;) {
+            // the frames already read are parsed in place
+            std::string_view head(in_.data() + head_, in_.size() - head_);
+            if (head.size() >= kFrameSize) {
+                uint32_t size = 0;
+                binary_convert<uint32_t>::decode(head, size);
+                if (size < kFrameHeader - kFrameSize || size > max_frame_) {
+                    close();
+                    co_return false;
+                }
+                if (head.size() >= size) {
+                    std::string_view body = head.substr(0, size);
+                    uint8_t type          = 0;
+                    binary_convert<uint64_t>::decode(body, f.id);
+                    binary_convert<uint8_t>::decode(body, type);
+                    f.type    = frame_type(type);
+                    f.payload = body;
+                    head_ += kFrameSize + size;
+                    co_return true;
+                }
+            }
+
+            // drop the frames returned, before reading more
+            in_.erase(0, head_);
+            head_    = 0;
+            size_t n = in_.size();
+            in_.resize(n + kReadSize);
+            boost::system::error_code ec;
+            size_t got = co_await stream_.async_read_some(
+                boost::asio::buffer(in_.data() + n, kReadSize),
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            in_.resize(n + got);
+            if (ec) {
+                close();
+                co_return false;
+            }
+        }
+    }
+
+    /// a frame to fill, and `send()` it
+    std::string& out() noexcept { return out_; }
+
+    void send() {
+        if (writing_ || out_.empty() || closed_) {
+            return;
+        }
+        writing_ = true;
+        boost::asio::co_spawn(stream_.get_executor(), write(this->shared_from_this()),
+                              boost::asio::detached);
+    }
+
+    void close() {
+        if (!closed_) {
+            closed_ = true;
+            boost::system::error_code ec;
+            stream_.close(ec);
+            wake_.cancel();
+        }
+    }
+
+    bool closed() const noexcept { return closed_; }
+
+    /// the bytes queued or being written
+    size_t buffered() const noexcept { return out_.size() + writing_buf_.size(); }
+
+    /// until `notify()`, a write completes, or the channel is closed. One waiter.
+    boost::asio::awaitable<void> wait() {
+        if (closed_) {
+            co_return;
+        }
+        wake_.expires_at(boost::asio::steady_timer::time_point::max());
+        boost::system::error_code ec;
+        co_await wake_.async_wait(
+            boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+    }
+
+    void notify() { wake_.cancel(); }
+
+private:
+    static constexpr size_t kReadSize = 16 * 1024;
+
+    static boost::asio::awaitable<void> write(std::shared_ptr<channel> self) {
+        while (!self->out_.empty() && !self->closed_) {
+            std::swap(self->out_, self->writing_buf_);
+            boost::system::error_code ec;
+            co_await boost::asio::async_write(
+                self->stream_, boost::asio::buffer(self->writing_buf_),
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            self->writing_buf_.clear();
+            self->notify();
+            if (ec) {
+                self->close();
+            }
+        }
+        self->writing_ = false;
+    }
+
+private:
+    Stream stream_;
+    const size_t max_frame_;
+
+    std::string in_;
+    // where the next frame starts in `in_`
+    size_t head_ = 0;
+
+    std::string out_;
+    std::string writing_buf_;
+    bool writing_ = false;
+    bool closed_  = false;
+    boost::asio::steady_timer wake_;
+};
+
+}  // namespace detail
+
+}  // namespace rpc
+}  // namespace ccl2
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/function.h>
+#include <ccl2/rpc/codec.h>
+#include <ccl2/rpc/frame.h>
+#include <ccl2/service.h>
+#include <ccl2/topic.h>
+#include <ccl2/type_traits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+namespace rpc {
+
+//!
+//! Serve the handlers of a Service over a stream socket, TCP or Unix domain.
+//!
+//!     static const ccl2::Topic<int(int, int)> kAdd{"/add"};
+//!     svc.register_handler(kAdd, [](int a, int b) { return a + b; });
+//!
+//!     ccl2::rpc::Server server(svc);
+//!     server.expose(kAdd);
+//!     asio::local::stream_protocol::acceptor acceptor(ioc, {"/tmp/svc.sock"});
+//!     asio::co_spawn(ioc, server.serve(acceptor), asio::detached);
+//!
+//! The requests of a connection are pipelined and answered as they finish: a handler
+//! returning `asio::awaitable<R>` does not hold up the requests behind it while it is
+//! suspended. The handlers run on the strand of their connection though, a synchronous
+//! handler blocks that connection until it returns; move blocking work off the strand,
+//! e.g. with `ccl2::offload()`. The exception thrown by a handler is sent back to the
+//! caller.
+//!
+//! A connection stops reading requests while `max_inflight` of them are being served,
+//! or while more than `max_buffered` bytes of responses wait to be written to a slow
+//! reader. The client then blocks on a full socket.
+//!
+//! `stop()`, also called by the destructor, closes the acceptors being served and the
+//! live connections. The coroutines still running share the state of the server, so
+//! it may be destroyed while clients are connected.
+//!
+template <class ServiceType>
+class Server : boost::noncopyable {
+public:
+    struct options_t {
+        /// the largest frame accepted, the connection is closed beyond
+        size_t max_frame = 16 * 1024 * 1024;
+        /// the requests of a connection served at the same time
+        size_t max_inflight = 1024;
+        /// the bytes of responses of a connection not written yet
+        size_t max_buffered = 16 * 1024 * 1024;
+    };
+
+    explicit Server(ServiceType& svc, options_t options = {})
+      : svc_(svc), state_(std::make_shared<state_t>(options)) {}
+
+    ~Server() { stop(); }
+
+    /// `svc` must be registered already, not thread safe with `serve()`
+    template <class Signature>
+    void expose(const Topic<Signature>& svc) {
+        using R = ct::return_type_t<Signature>;
+        using Args = ct::args_t<Signature, wire_tuple_t>;
+
+        auto handle = svc_.resolve(svc);
+        auto method = [handle](std::string_view in,
+                               std::string& out) -> boost::asio::awaitable<void> {
+            Args args;
+            rpc::decode(in, args);
+            detail::expect(in.empty(), "Expect: eof, got trailing bytes");
+            auto call = [&](auto&... a) { return handle(std::move(a)...); };
+            if constexpr (std::is_void_v<R>) {
+                std::apply(call, args);
+            } else if constexpr (std::is_same_v<R, boost::asio::awaitable<void>>) {
+                co_await std::apply(call, args);
+            } else if constexpr (is_awaitable<R>::value) {
+                rpc::encode(out, co_await std::apply(call, args));
+            } else {
+                rpc::encode(out, std::apply(call, args));
+            }
+        };
+        if (!state_->methods.emplace(svc.name(), std::move(method)).second) {
+            throw std::runtime_error("dup svc: " + svc.name());
+        }
+    }
+
+    /// accept and serve connections until the acceptor is closed or `stop()`
+    template <class Acceptor>
+    boost::asio::awaitable<void> serve(Acceptor& acceptor) {
+        return accept(state_, acceptor);
+    }
+
+    /// close the acceptors and the connections, the handlers running are not
+    /// interrupted but their responses are dropped. Thread safe.
+    void stop() { state_->stop(); }
+
+private:
+    template <class... Args>
+    using wire_tuple_t = std::tuple<detail::wire_t<Args>...>;
+
+    using method_type =
+        std::function<boost::asio::awaitable<void>(std::string_view, std::string&)>;
+
+    // shared with the coroutines, which may outlive the server
+    struct state_t {
+        explicit state_t(const options_t& o) : options(o) {}
+
+        /// `closer` is called by `stop()`, or right away if stopped already
+        /// @return: the key to `untrack()`
+        size_t track(std::function<void()> closer) {
+            {
+                std::lock_guard _lck{mtx};
+                if (!stopped) {
+                    closers.emplace(++next, std::move(closer));
+                    return next;
+                }
+            }
+            closer();
+            return 0;
+        }
+
+        void untrack(size_t key) {
+            std::lock_guard _lck{mtx};
+            closers.erase(key);
+        }
+
+        void stop() {
+            std::unordered_map<size_t, std::function<void()>> r;
+            {
+                std::lock_guard _lck{mtx};
+                stopped = true;
+                std::swap(r, closers);
+            }
+            for (auto& kv : r) {
+                kv.second();
+            }
+        }
+
+        const options_t options;
+        std::unordered_map<std::string, method_type, ccl2::detail::topic_hash,
+                           ccl2::detail::topic_equal>
+            methods;
+
+        std::mutex mtx;
+        bool stopped = false;
+        size_t next  = 0;
+        // close an acceptor or a connection, on its own executor
+        std::unordered_map<size_t, std::function<void()>> closers;
+    };
+
+    template <class Acceptor>
+    static boost::asio::awaitable<void> accept(std::shared_ptr<state_t> st,
+                                               Acceptor& acceptor) {
+        auto ex  = co_await boost::asio::this_coro::executor;
+        auto key = st->track([ex, &acceptor] {
+            boost::asio::dispatch(ex, [&acceptor] {
+                boost::system::error_code ec;
+                acceptor.close(ec);
+            });
+        });
+        for (;;) {
+            boost::system::error_code ec;
+            auto socket = co_await acceptor.async_accept(
+                boost::asio::make_strand(acceptor.get_executor()),
+                boost::asio::redirect_error(boost::asio::use_awaitable, ec));
+            if (ec == boost::asio::error::operation_aborted || !acceptor.is_open()) {
+                break;
+            }
+            if (ec) {
+                continue;
+            }
+            auto ch = std::make_shared<detail::channel<decltype(socket)>>(
+                std::move(socket), st->options.max_frame);
+            boost::asio::co_spawn(ch->stream().get_executor(), session(st, ch),
+                                  boost::asio::detached);
+        }
+        st->untrack(key);
+    }
+
+    template <class Channel>
+    static boost::asio::awaitable<void> session(std::shared_ptr<state_t> st,
+                                                std::shared_ptr<Channel> ch) {
+        auto key = st->track([ex = ch->stream().get_executor(), w = std::weak_ptr(ch)] {
+            boost::asio::dispatch(ex, [w] {
+                if (auto ch = w.lock()) {
+                    ch->close();
+                }
+            });
+        });
+        // shared with the requests, which may outlive the session
+        auto inflight = std::make_shared<size_t>(0);
+        frame_t f;
+        for (;;) {
+            while (!ch->closed()
+                   && (*inflight >= std::max<size_t>(st->options.max_inflight, 1)
+                       || ch->buffered() > st->options.max_buffered)) {
+                co_await ch->wait();
+            }
+            if (!co_await ch->read(f)) {
+                break;
+            }
+            if (f.type != frame_type::request) {
+                ch->close();
+                break;
+            }
+            // the payload is copied, the next read reuses the buffer
+            ++*inflight;
+            boost::asio::co_spawn(ch->stream().get_executor(),
+                                  dispatch(st, ch, f.id, std::string(f.payload)),
+                                  [ch, inflight](std::exception_ptr) {
+                                      --*inflight;
+                                      ch->notify();
+                                  });
+        }
+        st->untrack(key);
+    }
+
+    template <class Channel>
+    static boost::asio::awaitable<void> dispatch(std::shared_ptr<state_t> st,
+                                                 std::shared_ptr<Channel> ch,
+                                                 uint64_t id, std::string payload) {
+        std::string result;
+        // the message of an exception may be empty
+        bool failed = false;
+        std::string error;
+        try {
+            std::string_view in(payload);
+            std::string name;
+            rpc::decode(in, name);
+            auto it = st->methods.find(name);
+            if (it == st->methods.end()) {
+                throw std::runtime_error("expect svc: " + name);
+            }
+            co_await it->second(in, result);
+        } catch (const std::exception& e) {
+            failed = true;
+            error  = e.what();
+        } catch (...) {
+            failed = true;
+            error  = "unknown exception";
+        }
+
+        auto& out = ch->out();
+        size_t pos;
+        if (!failed) {
+            pos = detail::begin_frame(out, id, frame_type::response);
+            out.append(result);
+        } else {
+            pos = detail::begin_frame(out, id, frame_type::error);
+            rpc::encode(out, error);
+        }
+        detail::end_frame(out, pos);
+        ch->send();
+    }
+
+private:
+    ServiceType& svc_;
+    std::shared_ptr<state_t> state_;
+};
+
+}  // namespace rpc
+}  // namespace ccl2
@@ -1,85 +1,377 @@
 #pragma once
 
-#include <any>
+#include <atomic>
+#include <exception>
 #include <memory>
+#include <optional>
 #include <shared_mutex>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <utility>
-#include <vector>
+#include <boost/asio.hpp>
 #include <boost/core/noncopyable.hpp>
 #include <boost/hana.hpp>
 #include <ccl2/function.h>
+#include <ccl2/memoize.h>
+#include <ccl2/rcu.h>
 #include <ccl2/singleton_provider.h>
+#include <ccl2/topic.h>
 #include <ccl2/utils.h>
 
 namespace hana = boost::hana;
 
 namespace ccl2 {
 
+namespace detail {
+
+// the value of an awaitable handler
+template <class R>
+struct awaited {
+    using type = R;
+};
+
+#ifdef CCL2_USE_COROUTINES
+template <class R, class Executor>
+struct awaited<boost::asio::awaitable<R, Executor>> {
+    using type = R;
+};
+#endif
+
+template <class R>
+using awaited_t = typename awaited<R>::type;
+
+// of Service::async_call, R needs not be default constructible
+template <class R>
+struct call_completion {
+    using type = void(std::exception_ptr, std::optional<R>);
+};
+
+template <>
+struct call_completion<void> {
+    using type = void(std::exception_ptr);
+};
+
+}  // namespace detail
+
+//!
+//! A resolved service, see Service::resolve(). Calling through it does no lookup and
+//! takes no lock, the signature is checked once when it is resolved.
+//!
+//!     static const ccl2::Topic<int(int, int)> kAdd{"/add"};
+//!     auto add = svc.resolve(kAdd);
+//!     int r    = add(3, 4);
+//!
+//! Valid for the lifetime of the service.
+//!
+template <class Signature>
+class ServiceHandle {
+public:
+    using result_type = ct::return_type_t<Signature>;
+
+    ServiceHandle() = default;
+
+    /// mismatched Args... do not compile
+    template <class... Args>
+    result_type operator()(Args&&... args) const {
+        if (f_ == nullptr) {
+            throw std::runtime_error("invalid service handle");
+        }
+        return ccl2::invoke(with_signature<Signature>, *f_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return f_ != nullptr; }
+
+private:
+    template <class, template <class> class, template <class> class>
+    friend class Service;
+
+    explicit ServiceHandle(const ccl2::function<result_type>* f) : f_(f) {}
+
+    const ccl2::function<result_type>* f_ = nullptr;
+};
+
+//!
+//! Named services, one handler each.
+//!
+//! A call by name or Topic costs one hash lookup and no allocation. With RcuMutex the
+//! registry is copy-on-write, a call reads an immutable snapshot without waiting and
+//! without writing a shared cache line. The handlers are never removed, a handle
+//! resolved once needs no lookup at all.
+//!
 template <class MutexPolicy = NonMutex, template <class> class ReaderLock = MutexLock,
           template <class> class WriterLock = MutexLock>
 class Service : boost::noncopyable {
 public:
     using any_type = void*;
-    Service()      = default;
+
+    Service() : state_(new state_t) {}
+
+    ~Service() { delete state_.load(); }
 
     template <class F, class = hana::when<!std::is_member_function_pointer_v<F>>>
     void register_handler(std::string_view svc, F&& f) {
-        WriterLock<MutexPolicy> _lck{mtx_};
-        if (registry_.count(svc.data())) {
-            throw std::runtime_error("dup svc: " + std::string(svc));
-        }
-        auto bf    = ccl2::bind(std::forward<F>(f));
-        auto pbf   = std::make_shared<decltype(bf)>(std::move(bf));
-        any_type p = pbf.get();
-        registry_.emplace(std::string(svc), p);
-
-        auto v = std::make_any<decltype(pbf)>(pbf);
-        dummy_.emplace_back(v);
+        add(svc, ccl2::bind(std::forward<F>(f)));
     }
 
     template <class MF, class Obj,
               class = hana::when<std::is_member_function_pointer_v<MF>>>
     void register_handler(std::string_view svc, const MF& f, Obj obj) {
-        WriterLock<MutexPolicy> _lck{mtx_};
-        if (registry_.count(svc.data())) {
-            throw std::runtime_error("dup svc: " + std::string(svc));
-        }
-        auto bf    = ccl2::bind(f, obj);
-        auto pbf   = std::make_shared<decltype(bf)>(std::move(bf));
-        any_type p = pbf.get();
-        registry_.emplace(std::string(svc), p);
+        add(svc, ccl2::bind(f, obj));
+    }
 
-        auto v = std::make_any<decltype(pbf)>(std::move(pbf));
-        dummy_.emplace_back(v);
+    template <class Signature, class F>
+    void register_handler(const Topic<Signature>& svc, F&& f) {
+        add(svc.name(), ccl2::bind.template operator()<Signature>(std::forward<F>(f)));
     }
 
+    /// the results are cached, see ccl2::memoize()
+    template <class Signature, class F>
+    void register_handler(const Topic<Signature>& svc, F&& f,
+                          const MemoizeOptions& options) {
+        register_handler(svc, ccl2::memoize<Signature>(std::forward<F>(f), options));
+    }
+
+    /// throws std::runtime_error if R or Args... do not match the handler
     template <class R, class... Args>
     R call(std::string_view svc, Args&&... args) {
-        using T = ccl2::function<R>;
         ReaderLock<MutexPolicy> _lck{mtx_};
-        if (!registry_.count(svc.data())) {
-            throw std::runtime_error("expect svc: " + std::string(svc));
+        return ccl2::invoke(find<R>(svc), std::forward<Args>(args)...);
+    }
+
+    /// throws std::runtime_error if `svc` is not registered, or registered with
+    /// another signature
+    template <class Signature>
+    ServiceHandle<Signature> resolve(const Topic<Signature>& svc) {
+        using R = ct::return_type_t<Signature>;
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        auto& f = find<R>(svc);
+        if (!f.template accepts<detail::canonical_t<Signature>>()) {
+            throw std::runtime_error("signature mismatch: " + svc.name());
+        }
+        return ServiceHandle<Signature>(&f);
+    }
+
+    /// mismatched Args... do not compile, throws std::runtime_error if `svc` was
+    /// registered by name with another signature
+    template <class Signature, class... Args, class R = ct::return_type_t<Signature>>
+    R call(const Topic<Signature>& svc, Args&&... args) {
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        auto& f = find<R>(svc);
+        if (!f.template accepts<detail::canonical_t<Signature>>()) {
+            throw std::runtime_error("signature mismatch: " + svc.name());
+        }
+        return ccl2::invoke(with_signature<Signature>, f, std::forward<Args>(args)...);
+    }
+
+    /// Run the handler of `svc` on `ex`. The last argument is the completion token, of
+    /// signature void(std::exception_ptr, std::optional<R>), or void(std::exception_ptr)
+    /// if R is void:
+    ///
+    ///     svc.async_call<int>(ex, "/add", 1, 2,
+    ///                         [](std::exception_ptr e, std::optional<int> r) {});
+    ///     auto r = co_await svc.async_call<int>(ex, "/add", 1, 2, asio::use_awaitable);
+    ///
+    /// A handler returning `boost::asio::awaitable<R>` is co_spawn'ed on `ex`. The
+    /// arguments are copied, the errors of call() and of the handler are passed to
+    /// the completion, with an empty std::optional<R>.
+    template <class R, class Executor, class... Ts>
+    auto async_call(const Executor& ex, std::string_view svc, Ts&&... ts) {
+        static_assert(sizeof...(Ts) >= 1, "Expect: a completion token");
+        return async_call<R, void>(ex, std::string(svc),
+                                   std::forward_as_tuple(std::forward<Ts>(ts)...),
+                                   std::make_index_sequence<sizeof...(Ts) - 1>{});
+    }
+
+    /// mismatched Args... do not compile, R is the value of the awaitable returned
+    /// by `Signature`, if any. A handler registered by name with another signature
+    /// completes with std::runtime_error.
+    template <class Signature, class Executor, class... Ts>
+    auto async_call(const Executor& ex, const Topic<Signature>& svc, Ts&&... ts) {
+        static_assert(sizeof...(Ts) >= 1, "Expect: a completion token");
+        using R = detail::awaited_t<ct::return_type_t<Signature>>;
+        return async_call<R, Signature>(ex, svc,
+                                        std::forward_as_tuple(std::forward<Ts>(ts)...),
+                                        std::make_index_sequence<sizeof...(Ts) - 1>{});
+    }
+
+private:
+    static constexpr bool kCopyOnWrite = std::is_same_v<MutexPolicy, RcuMutex>;
+
+    struct entry_t {
+        // owns a function<R>, shared by the snapshots
+        std::shared_ptr<const void> owner;
+        any_type fn;
+        // typeid(R) of function<R>
+        const std::type_info* ret;
+    };
+
+    struct state_t {
+        std::unordered_map<std::string, entry_t, detail::topic_hash,
+                           detail::topic_equal>
+            registry;
+    };
+
+    template <class R>
+    void add(std::string_view svc, ccl2::function<R>&& f) {
+        auto pbf   = std::make_shared<ccl2::function<R>>(std::move(f));
+        any_type p = pbf.get();
+        entry_t entry{std::move(pbf), p, &typeid(R)};
+
+        WriterLock<MutexPolicy> _lck{mtx_};
+        auto* cur = state_.load();
+        if (cur->registry.count(svc)) {
+            throw std::runtime_error("dup svc: " + std::string(svc));
+        }
+        if constexpr (kCopyOnWrite) {
+            auto next = std::make_unique<state_t>(*cur);
+            next->registry.emplace(std::string(svc), std::move(entry));
+            state_.store(next.release());
+            mtx_.retire(cur);
+        } else {
+            cur->registry.emplace(std::string(svc), std::move(entry));
+        }
+    }
+
+    // called with the reader lock held
+    template <class Key>
+    const entry_t& lookup(const Key& svc) const {
+        const auto& registry = state_.load()->registry;
+        auto it              = registry.find(svc);
+        if (it == registry.end()) {
+            throw std::runtime_error("expect svc: "
+                                     + std::string(detail::topic_name(svc)));
         }
-        auto f = static_cast<T*>(registry_.at(std::string(svc)));
-        return ccl2::invoke(*f, std::forward<Args>(args)...);
+        return it->second;
     }
 
-    template <class R, class Executor, class... Args>
-    R async_call(std::string_view svc, Args&&... args,
-                 const std::function<void(const R&)>& callback);
+    // called with the reader lock held
+    template <class R, class Key>
+    const ccl2::function<R>& find(const Key& svc) const {
+        const auto& entry = lookup(svc);
+        if (*entry.ret != typeid(R)) {
+            throw std::runtime_error("result type mismatch: "
+                                     + std::string(detail::topic_name(svc)));
+        }
+        return *static_cast<const ccl2::function<R>*>(entry.fn);
+    }
+
+    // `Signature` void: checked by ccl2::invoke
+    template <class Signature, class R, class Key, class Args>
+    static R apply(const ccl2::function<R>& f, const Key& svc, Args& args) {
+        if constexpr (std::is_void_v<Signature>) {
+            (void)svc;
+            return std::apply(
+                [&](auto&... a) -> R { return ccl2::invoke(f, std::move(a)...); }, args);
+        } else {
+            if (!f.template accepts<detail::canonical_t<Signature>>()) {
+                throw std::runtime_error("signature mismatch: "
+                                         + std::string(detail::topic_name(svc)));
+            }
+            return std::apply(
+                [&](auto&... a) -> R {
+                    return ccl2::invoke(with_signature<Signature>, f, std::move(a)...);
+                },
+                args);
+        }
+    }
+
+    template <class R, class Signature, class Executor, class Key, class Tuple,
+              size_t... I>
+    auto async_call(const Executor& ex, Key svc, Tuple&& ts, std::index_sequence<I...>) {
+        auto&& token = std::get<sizeof...(I)>(ts);
+        return boost::asio::async_initiate<decltype(token),
+                                           typename detail::call_completion<R>::type>(
+            [this, ex](auto handler, Key svc, auto args) {
+                auto work = boost::asio::make_work_guard(
+                    boost::asio::get_associated_executor(handler, ex));
+                boost::asio::post(ex, [this, ex, svc = std::move(svc),
+                                       args    = std::move(args),
+                                       handler = std::move(handler),
+                                       work    = std::move(work)]() mutable {
+                    run<R, Signature>(ex, svc, args, handler, work);
+                });
+            },
+            token, std::move(svc),
+            std::make_tuple(std::get<I>(std::forward<Tuple>(ts))...));
+    }
+
+    // on `ex`
+    template <class R, class Signature, class Executor, class Key, class Args,
+              class Handler, class Work>
+    void run(const Executor& ex, const Key& svc, Args& args, Handler& handler,
+             Work& work) {
+        std::exception_ptr eptr;
+        std::conditional_t<std::is_void_v<R>, bool, std::optional<R>> result{};
+        try {
+            ReaderLock<MutexPolicy> _lck{mtx_};
+#ifdef CCL2_USE_COROUTINES
+            using awaitable_type = boost::asio::awaitable<R>;
+            const auto& entry    = lookup(svc);
+            if (*entry.ret == typeid(awaitable_type)) {
+                // the registry outlives the handler, the arguments live in the lambda
+                const auto& f =
+                    *static_cast<const ccl2::function<awaitable_type>*>(entry.fn);
+                // co_spawn completes with a default constructed value on error
+                using spawned_type = boost::asio::awaitable<
+                    std::conditional_t<std::is_void_v<R>, void, std::optional<R>>>;
+                boost::asio::co_spawn(
+                    ex,
+                    [&f, svc, args = std::move(args)]() mutable -> spawned_type {
+                        if constexpr (std::is_void_v<R>) {
+                            co_await apply<Signature>(f, svc, args);
+                        } else {
+                            R r = co_await apply<Signature>(f, svc, args);
+                            co_return std::optional<R>(std::move(r));
+                        }
+                    },
+                    [handler = std::move(handler), work = std::move(work)](
+                        std::exception_ptr e, auto... r) mutable {
+                        complete(handler, work, e, std::move(r)...);
+                    });
+                return;
+            }
+#else
+            (void)ex;
+#endif
+            const auto& f = find<R>(svc);
+            if constexpr (std::is_void_v<R>) {
+                apply<Signature>(f, svc, args);
+            } else {
+                result.emplace(apply<Signature>(f, svc, args));
+            }
+        } catch (...) {
+            eptr = std::current_exception();
+        }
+
+        if constexpr (std::is_void_v<R>) {
+            complete(handler, work, eptr);
+        } else {
+            complete(handler, work, eptr, std::move(result));
+        }
+    }
+
+    // on the executor associated with `handler`
+    template <class Handler, class Work, class... Results>
+    static void complete(Handler& handler, Work& work, Results&&... results) {
+        auto ex = work.get_executor();
+        boost::asio::dispatch(
+            ex, [handler = std::move(handler), work = std::move(work),
+                 r = std::make_tuple(std::forward<Results>(results)...)]() mutable {
+                std::apply(handler, std::move(r));
+            });
+    }
 
 private:
     MutexPolicy mtx_;
-    std::vector<std::any> dummy_;
-    std::unordered_map<std::string, any_type> registry_;
+    std::atomic<state_t*> state_;
 };
 
 using ServiceProvider = SingletonProvider<Service<>>;
-using ConcurrentServiceProvider =
-    SingletonProvider<Service<std::shared_mutex, std::shared_lock>>;
+using ConcurrentServiceProvider = SingletonProvider<Service<RcuMutex, std::shared_lock>>;
 
 }  // namespace ccl2
@@ -1,79 +1,602 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
 #include <type_traits>
+#include <typeinfo>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include <boost/core/noncopyable.hpp>
 #include <ccl2/function.h>
+#include <ccl2/rcu.h>
 #include <ccl2/singleton_provider.h>
+#include <ccl2/topic.h>
 #include <ccl2/utils.h>
+#include <stddef.h>
+#include <stdint.h>
 
 namespace ccl2 {
 
+namespace detail {
+
+// never 0, the id of no signal
+inline uint32_t next_signal_id() {
+    static std::atomic<uint32_t> ids{0};
+    uint32_t id;
+    while ((id = ++ids) == 0) {
+    }
+    return id;
+}
+
+}  // namespace detail
+
+//!
+//! Topic based signal/slot.
+//!
+//! Topics are interned into a flat array, `resolve()` turns a name into a handle,
+//! an index into that array. Emitting through a handle does no hashing and no
+//! allocation, emitting by name costs one hash. A typed Topic is interned on its
+//! first emit and caches its index, the next emits through it cost as a handle.
+//!
+//! With RcuMutex the registry is copy-on-write: emit reads an immutable snapshot
+//! without waiting, registration and removal publish a new one. A handler removed
+//! may still be running in an emit started before.
+//!
+//! Topics are path-like, a handler may subscribe to a pattern: `*` matches one level,
+//! `#` as the last level matches the rest (see detail::topic_match).
+//!
+//!     sig.register_handler("/sensor/*/temp", on_temp);
+//!     sig.register_handler("/sensor/#", on_any);
+//!     sig.emit("/sensor/17/temp", 21.5);    // on_temp, then on_any
+//!
+//! The patterns are kept in a trie, matching a topic walks it once, level by level.
+//! The handlers matched are cached in the interned topic until a subscription
+//! changes, so emitting through a handle costs the same on a matched topic as on an
+//! exact one. Emitting by name does not intern the topic: the match is kept in a
+//! bounded LRU cache, cleared when a subscription changes, so a stream of distinct
+//! topics (`/sensor/<id>`) does not grow the registry. That cache is split in 16
+//! shards, each under a mutex even with RcuMutex: an emit by name of a topic matched
+//! by a pattern but not interned takes one of them (see BM_signal_emit_wildcard in
+//! bench_signal.cpp), `resolve()` the hot topics to emit without it.
+//!
 template <class MutexPolicy = NonMutex, template <class> class ReaderLock = MutexLock,
           template <class> class WriterLock = MutexLock>
 class Signal final : public boost::noncopyable {
 public:
-    Signal() = default;
+    /// a resolved topic, valid for the lifetime of the signal, also after `remove()`.
+    /// `Signature` void: the arguments are checked at runtime.
+    template <class Signature = void>
+    struct handle_t {
+        size_t index = size_t(-1);
+    };
+
+    /// a handler registered, to remove it alone
+    struct subscription_t {
+        uint64_t seq = 0;
+    };
+
+    Signal() : id_(detail::next_signal_id()), state_(new state_t) {}
+
+    ~Signal() { delete state_.load(); }
 
     template <class Signature, class Callable>
-    void register_handler2(std::string_view topic, Callable&& call) {
-        WriterLock<MutexPolicy> _lck{mtx_};
-        registry_.emplace(
-            std::string(topic),
-            ccl2::bind.template operator()<Signature>(std::forward<Callable>(call)));
+    subscription_t register_handler2(std::string_view topic, Callable&& call) {
+        return add(topic, ccl2::bind.template operator()<Signature>(
+                              std::forward<Callable>(call)));
     }
 
+    // the value returned by a handler is dropped
     template <class F, class = std::enable_if_t<!std::is_member_function_pointer_v<F>>>
-    void register_handler(std::string_view topic, F&& f) {
-        WriterLock<MutexPolicy> _lck{mtx_};
-        registry_.emplace(std::string(topic), ccl2::bind(std::forward<F>(f)));
+    subscription_t register_handler(std::string_view topic, F&& f) {
+        using Signature = ct::apply_return_t<ct::function_type_t<std::decay_t<F>>, void>;
+        return register_handler2<Signature>(topic, std::forward<F>(f));
     }
 
     // NOTICE: lifetime of T
     // Obj * or std::shared_ptr<Obj>
     template <class MemFn, class Obj,
               class = std::enable_if_t<std::is_member_function_pointer_v<MemFn>>>
-    void register_handler(std::string_view topic, const MemFn& mem, Obj obj) {
-        WriterLock<MutexPolicy> _lck{mtx_};
-        registry_.emplace(std::string(topic), ccl2::bind(mem, obj));
+    subscription_t register_handler(std::string_view topic, const MemFn& mem, Obj obj) {
+        using Args =
+            typename detail::tuple_pop_front<ct::args_t<MemFn, std::tuple>>::type;
+        if (obj == nullptr) {
+            throw std::runtime_error("self is a nullptr");
+        }
+        return add(topic, detail::erased<void, Args>::wrap([mem, obj](auto&&... args) {
+                   std::invoke(mem, obj, std::forward<decltype(args)>(args)...);
+               }));
+    }
+
+    template <class Signature, class F>
+    subscription_t register_handler(const Topic<Signature>& topic, F&& f) {
+        static_assert(std::is_void_v<ct::return_type_t<Signature>>,
+                      "Expect: Topic<void(Args...)>");
+        return register_handler2<Signature>(topic.name(), std::forward<F>(f));
     }
 
+    /// intern `topic`, it need not have handlers yet. Throws std::runtime_error if
+    /// the patterns matching `topic` take different arguments.
+    handle_t<> resolve(std::string_view topic) { return handle_t<>{intern(topic)}; }
+
+    /// throws std::runtime_error if the handlers of `topic` take other arguments
+    template <class Signature>
+    handle_t<Signature> resolve(const Topic<Signature>& topic) {
+        size_t index = intern(topic.name());
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        check<Signature>(state_.load()->topics[index]);
+        return handle_t<Signature>{index};
+    }
+
+    /// throws std::runtime_error if Args... do not match the handlers of `topic`
     template <class... Args>
     void emit(std::string_view topic, Args&&... args) {
+        emit_by_name<void>(topic, args...);
+    }
+
+    /// mismatched Args... do not compile, throws std::runtime_error if the handlers
+    /// of `topic` were registered by name with another signature
+    template <class Signature, class... Args>
+    void emit(const Topic<Signature>& topic, Args&&... args) {
+        size_t index = slot(topic);
+        if (index == npos) {
+            emit_by_name<Signature>(topic, args...);
+        } else {
+            emit(handle_t<Signature>{index}, args...);
+        }
+    }
+
+    template <class Signature, class... Args>
+    void emit(handle_t<Signature> topic, Args&&... args) {
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        const auto& s = *state_.load();
+        if (topic.index >= s.topics.size()) {
+            throw std::runtime_error("invalid topic handle");
+        }
+        dispatch<Signature>(s.topics[topic.index], args...);
+    }
+
+    /// emit each tuple of `items`, under one lock and one snapshot
+    template <class Signature, class Range>
+    void emit_all(handle_t<Signature> topic, const Range& items) {
         ReaderLock<MutexPolicy> _lck{mtx_};
-        auto range = registry_.equal_range(topic.data());
-        for (auto it = range.first; it != range.second; ++it) {
-            ccl2::invoke(it->second, args...);
+        const auto& s = *state_.load();
+        if (topic.index >= s.topics.size()) {
+            throw std::runtime_error("invalid topic handle");
+        }
+        const auto& t = s.topics[topic.index];
+        for (const auto& item : items) {
+            std::apply([&](const auto&... args) { dispatch<Signature>(t, args...); },
+                       item);
         }
     }
 
+    /// emit on `executor` later, the arguments are copied. See BatchEmitter to emit
+    /// many events on the same topic.
     template <class Executor, class... Args>
     void emit_on(Executor& executor, std::string_view topic, Args&&... args) {
-        // executor.e
-        std::function<void(std::string, Args...)> f = [this](std::string _topic,
-                                                             Args&&... _args) {
-            emit(_topic, std::forward<Args>(_args)...);
-        };
-        executor.enqueue(std::bind(f, std::string(topic), std::forward<Args>(args)...));
+        executor.enqueue([this, topic = std::string(topic),
+                          args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+            std::apply([&](auto&... a) { emit(topic, a...); }, args);
+        });
     }
 
+    /// remove the handlers of `topic`, or of the pattern `topic`
     void remove(std::string_view topic) {
+        bool pattern = detail::is_topic_pattern(topic);
+        update([&](state_t& s) {
+            if (!pattern) {
+                auto it = s.index.find(topic);
+                if (it != s.index.end()) {
+                    s.topics[it->second].exact.clear();
+                    relink(s, s.topics[it->second]);
+                }
+                return;
+            }
+            size_t n = 0;
+            for (auto level : detail::topic_levels(topic)) {
+                auto it = s.trie[n].children.find(level);
+                if (it == s.trie[n].children.end()) {
+                    return;
+                }
+                n = it->second;
+            }
+            s.patterns -= s.trie[n].handlers.size();
+            s.trie[n].handlers.clear();
+            relink(s, topic);
+        });
+    }
+
+    /// remove the handler of `sub`, nothing if it is removed already
+    void remove(subscription_t sub) {
+        auto erase = [&](ordered_type& handlers) {
+            auto it = std::find_if(handlers.begin(), handlers.end(),
+                                   [&](const auto& h) { return h.first == sub.seq; });
+            if (it == handlers.end()) {
+                return false;
+            }
+            handlers.erase(it);
+            return true;
+        };
+        update([&](state_t& s) {
+            for (auto& t : s.topics) {
+                if (erase(t.exact)) {
+                    relink(s, t);
+                    return;
+                }
+            }
+            for (auto& node : s.trie) {
+                if (erase(node.handlers)) {
+                    s.patterns--;
+                    for (auto& t : s.topics) {
+                        relink(s, t);
+                    }
+                    return;
+                }
+            }
+        });
+    }
+
+    /// the number of handlers an emit on `topic` runs
+    size_t handler_count(std::string_view topic) {
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        const auto& s = *state_.load();
+        auto it       = s.index.find(topic);
+        if (it != s.index.end()) {
+            return s.topics[it->second].handlers.size();
+        }
+        return s.patterns == 0 ? 0 : match(s, topic).size();
+    }
+
+private:
+    static constexpr bool kCopyOnWrite = std::is_same_v<MutexPolicy, RcuMutex>;
+
+    // handlers are shared by the snapshots
+    using handler_type = std::shared_ptr<const ccl2::function<void>>;
+
+    using index_type =
+        std::unordered_map<std::string, size_t, detail::topic_hash, detail::topic_equal>;
+
+    // the registration order, to interleave the exact and the pattern handlers
+    using ordered_type = std::vector<std::pair<uint64_t, handler_type>>;
+
+    struct topic_t {
+        std::string name;
+        ordered_type exact;
+        // exact and matched, in registration order
+        std::vector<handler_type> handlers;
+        // the signature of the handlers, null if none is checked
+        const std::type_info* signature = nullptr;
+    };
+
+    struct node_t {
+        index_type children;
+        ordered_type handlers;
+    };
+
+    struct state_t {
+        index_type index;
+        std::vector<topic_t> topics;
+        // of the patterns, the root first
+        std::vector<node_t> trie = std::vector<node_t>(1);
+        uint64_t seq             = 0;
+        // the number of pattern handlers
+        size_t patterns = 0;
+        // bumped by every update, of the matches cached
+        uint64_t version = 0;
+    };
+
+    // a shard of the matches of the topics emitted by name but not interned, of one
+    // version, least recently used evicted first
+    struct alignas(64) matches_t {
+        std::conditional_t<std::is_same_v<MutexPolicy, NonMutex>, NonMutex, std::mutex>
+            mtx;
+        uint64_t version = 0;
+        // the most recently used first
+        std::list<std::shared_ptr<const topic_t>> lru;
+        // views of the names in `lru`
+        std::unordered_map<std::string_view,
+                           typename std::list<std::shared_ptr<const topic_t>>::iterator>
+            index;
+    };
+
+    // by the hash of the topic, emitters on different topics rarely share a lock
+    static constexpr size_t kMatchShards = 16;
+    // of each shard
+    static constexpr size_t kMaxMatches = 64;
+
+    // in place, or on a copy which is published if `f` does not throw
+    template <class F>
+    void update(F&& f) {
         WriterLock<MutexPolicy> _lck{mtx_};
-        auto range = registry_.equal_range(topic.data());
-        registry_.erase(range.first, range.second);
+        if constexpr (kCopyOnWrite) {
+            auto* cur = state_.load();
+            auto next = std::make_unique<state_t>(*cur);
+            f(*next);
+            uint64_t version = ++next->version;
+            state_.store(next.release());
+            mtx_.retire(cur);
+            clear_matches(version);
+        } else {
+            // no reader, the matches are dropped before `f` may throw halfway
+            auto& s = *state_.load(std::memory_order_relaxed);
+            clear_matches(++s.version);
+            f(s);
+        }
+    }
+
+    // an emit on a snapshot older than `version` does not cache what it matches.
+    // Cleared right away, the handlers removed are not kept alive by the cache.
+    void clear_matches(uint64_t version) {
+        for (auto& m : matches_) {
+            MutexLock<decltype(m.mtx)> _lck{m.mtx};
+            m.index.clear();
+            m.lru.clear();
+            m.version = version;
+        }
+    }
+
+    template <class Signature, class Key, class... Args>
+    void emit_by_name(const Key& topic, Args&... args) {
+        ReaderLock<MutexPolicy> _lck{mtx_};
+        const auto& s = *state_.load();
+        auto it       = s.index.find(topic);
+        if (it != s.index.end()) {
+            dispatch<Signature>(s.topics[it->second], args...);
+        } else if (s.patterns > 0) {
+            // the handlers run with the matches unlocked, they may emit
+            auto t = matched(s, detail::topic_name(topic));
+            dispatch<Signature>(*t, args...);
+        }
+    }
+
+    // under the reader lock, the pattern handlers of `topic` not interned. Throws
+    // std::runtime_error if they take different arguments.
+    std::shared_ptr<const topic_t> matched(const state_t& s, std::string_view topic) {
+        auto& m = matches_[std::hash<std::string_view>{}(topic) % kMatchShards];
+        {
+            MutexLock<decltype(m.mtx)> _lck{m.mtx};
+            if (m.version == s.version) {
+                auto it = m.index.find(topic);
+                if (it != m.index.end()) {
+                    m.lru.splice(m.lru.begin(), m.lru, it->second);
+                    return *it->second;
+                }
+            }
+        }
+        auto t  = std::make_shared<topic_t>();
+        t->name = std::string(topic);
+        relink(s, *t);
+
+        MutexLock<decltype(m.mtx)> _lck{m.mtx};
+        if (m.version == s.version && m.index.find(topic) == m.index.end()) {
+            if (m.lru.size() >= kMaxMatches) {
+                m.index.erase(m.lru.back()->name);
+                m.lru.pop_back();
+            }
+            m.lru.push_front(t);
+            m.index.emplace(m.lru.front()->name, m.lru.begin());
+        }
+        return t;
+    }
+
+    static size_t intern(state_t& s, std::string_view topic) {
+        auto it = s.index.find(topic);
+        if (it != s.index.end()) {
+            return it->second;
+        }
+        if (detail::is_topic_pattern(topic)) {
+            throw std::runtime_error("Expect: a topic, got a pattern: "
+                                     + std::string(topic));
+        }
+        // linked first, the patterns it matches may not agree
+        topic_t t{std::string(topic), {}, {}};
+        relink(s, t);
+        s.topics.emplace_back(std::move(t));
+        s.index.emplace(std::string(topic), s.topics.size() - 1);
+        return s.topics.size() - 1;
+    }
+
+    static constexpr size_t npos = size_t(-1);
+
+    // the index of `topic`, interned on the first emit and cached in the topic, npos
+    // if it is a pattern
+    template <class Signature>
+    size_t slot(const Topic<Signature>& topic) {
+        uint64_t v = topic.slot().value.load(std::memory_order_acquire);
+        if ((v >> 32) == id_) {
+            return size_t(v & 0xffffffff);
+        }
+        if (detail::is_topic_pattern(topic.name())) {
+            return npos;
+        }
+        size_t index = intern(topic.name());
+        topic.slot().value.store((uint64_t(id_) << 32) | index,
+                                 std::memory_order_release);
+        return index;
+    }
+
+    size_t intern(std::string_view topic) {
+        {
+            ReaderLock<MutexPolicy> _lck{mtx_};
+            const auto& s = *state_.load();
+            auto it       = s.index.find(topic);
+            if (it != s.index.end()) {
+                return it->second;
+            }
+        }
+        size_t index = 0;
+        update([&](state_t& s) { index = intern(s, topic); });
+        return index;
+    }
+
+    // the pattern handlers of `topic`, in registration order. Depth first through
+    // the trie, one level of `topic` per step.
+    static ordered_type match(const state_t& s, std::string_view topic) {
+        ordered_type r;
+        match(s, 0, detail::topic_levels(topic), 0, r);
+        std::sort(r.begin(), r.end(),
+                  [](const auto& a, const auto& b) { return a.first < b.first; });
+        return r;
+    }
+
+    static void match(const state_t& s, size_t n,
+                      const std::vector<std::string_view>& levels, size_t i,
+                      ordered_type& r) {
+        const auto& node = s.trie[n];
+        auto it          = node.children.find(std::string_view("#"));
+        if (it != node.children.end()) {
+            const auto& h = s.trie[it->second].handlers;
+            r.insert(r.end(), h.begin(), h.end());
+        }
+        if (i == levels.size()) {
+            r.insert(r.end(), node.handlers.begin(), node.handlers.end());
+            return;
+        }
+        it = node.children.find(levels[i]);
+        if (it != node.children.end()) {
+            match(s, it->second, levels, i + 1, r);
+        }
+        it = node.children.find(std::string_view("*"));
+        if (levels[i] != "*" && it != node.children.end()) {
+            match(s, it->second, levels, i + 1, r);
+        }
+    }
+
+    // rebuild the cached handlers of `t`. Throws std::runtime_error, `t` unchanged,
+    // if they take different arguments: overlapping patterns, `/a/*` and `/*/b`, are
+    // only checked against each other when a topic they both match is interned.
+    static void relink(const state_t& s, topic_t& t) {
+        auto all = t.exact;
+        if (s.patterns > 0) {
+            auto matched = match(s, t.name);
+            all.insert(all.end(), matched.begin(), matched.end());
+            std::sort(all.begin(), all.end(),
+                      [](const auto& a, const auto& b) { return a.first < b.first; });
+        }
+        const std::type_info* signature = nullptr;
+        for (const auto& [_, h] : all) {
+            if (signature == nullptr) {
+                signature = h->signature();
+            } else if (h->signature() && *h->signature() != *signature) {
+                throw std::runtime_error("signature mismatch: " + t.name);
+            }
+        }
+        t.signature = signature;
+        t.handlers.clear();
+        for (auto& [_, h] : all) {
+            t.handlers.emplace_back(std::move(h));
+        }
+    }
+
+    // of the interned topics matching `pattern`
+    static void relink(state_t& s, std::string_view pattern) {
+        for (auto& t : s.topics) {
+            if (detail::topic_match(pattern, t.name)) {
+                relink(s, t);
+            }
+        }
+    }
+
+    static void check(const handler_type& a, const handler_type& b,
+                      std::string_view topic) {
+        if (a->signature() && b->signature() && *a->signature() != *b->signature()) {
+            throw std::runtime_error("signature mismatch: " + std::string(topic));
+        }
+    }
+
+    // the handlers of `t` take the arguments of `Signature`, once per topic rather
+    // than per handler. They may be registered by name after the topic is resolved.
+    template <class Signature>
+    static void check(const topic_t& t) {
+        const auto& expected = typeid(detail::canonical_t<Signature>);
+        if (t.signature && t.signature != &expected && *t.signature != expected) {
+            throw std::runtime_error("signature mismatch: " + t.name);
+        }
+    }
+
+    // all the handlers of a topic take the same arguments, the handlers of a pattern
+    // take the arguments of the topics it matches
+    subscription_t add(std::string_view topic, ccl2::function<void>&& f) {
+        auto h       = std::make_shared<const ccl2::function<void>>(std::move(f));
+        bool pattern = detail::is_topic_pattern(topic);
+        subscription_t sub;
+        update([&](state_t& s) {
+            if (!pattern) {
+                auto& t = s.topics[intern(s, topic)];
+                for (const auto& other : t.handlers) {
+                    check(other, h, t.name);
+                }
+                sub.seq = ++s.seq;
+                t.exact.emplace_back(sub.seq, std::move(h));
+                relink(s, t);
+                return;
+            }
+            // checked before any change, the state is updated in place without RCU
+            for (const auto& t : s.topics) {
+                if (detail::topic_match(topic, t.name)) {
+                    for (const auto& other : t.handlers) {
+                        check(other, h, t.name);
+                    }
+                }
+            }
+            size_t n = 0;
+            for (auto level : detail::topic_levels(topic)) {
+                auto it = s.trie[n].children.find(level);
+                if (it == s.trie[n].children.end()) {
+                    // may reallocate the trie
+                    s.trie.emplace_back();
+                    it = s.trie[n].children.emplace(std::string(level), s.trie.size() - 1)
+                             .first;
+                }
+                n = it->second;
+            }
+            for (const auto& [_, other] : s.trie[n].handlers) {
+                check(other, h, topic);
+            }
+            sub.seq = ++s.seq;
+            s.trie[n].handlers.emplace_back(sub.seq, std::move(h));
+            s.patterns++;
+            relink(s, topic);
+        });
+        return sub;
+    }
+
+    // `Signature` void: checked by ccl2::invoke
+    template <class Signature, class... Args>
+    static void dispatch(const topic_t& t, Args&... args) {
+        if constexpr (!std::is_void_v<Signature>) {
+            check<Signature>(t);
+        }
+        for (const auto& h : t.handlers) {
+            const auto& f = *h;
+            if constexpr (std::is_void_v<Signature>) {
+                ccl2::invoke(f, args...);
+            } else {
+                ccl2::invoke(with_signature<Signature>, f, args...);
+            }
+        }
     }
 
 private:
+    // of the slots cached in the topics
+    const uint32_t id_;
     MutexPolicy mtx_;
-    std::unordered_multimap<std::string, ccl2::function<void>> registry_;
+    std::atomic<state_t*> state_;
+    std::array<matches_t, kMatchShards> matches_;
 };
 
 using SignalProvider = SingletonProvider<Signal<>>;
-using ConcurrentSignalProvider =
-    SingletonProvider<Signal<std::shared_mutex, std::shared_lock>>;
+using ConcurrentSignalProvider = SingletonProvider<Signal<RcuMutex, std::shared_lock>>;
 
 }  // namespace ccl2
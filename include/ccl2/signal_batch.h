@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/ring_buffer.h>
+#include <ccl2/signal.h>
+#include <ccl2/topic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+//!
+//! Batched asynchronous emit on one topic.
+//!
+//! `emit()` copies the arguments into a lock-free buffer, the events are delivered on
+//! the executor up to `max_batch` at a time through Signal::emit_all: one handler
+//! dispatch and one registry lookup per batch instead of one per event. A batch is
+//! delivered once it is full, or `max_delay` after its first event.
+//!
+//!     static const ccl2::Topic<void(int, double)> kSensor{"/sensor"};
+//!     ccl2::BatchEmitter emitter(sig, kSensor, pool.get_executor());
+//!     emitter.emit(1, 2.0);
+//!
+//! The events of one producer are delivered in order. The events buffered when the
+//! emitter is destroyed are still delivered, the signal must outlive them.
+//!
+template <class SignalType, class Signature>
+class BatchEmitter : boost::noncopyable {
+    template <class... Args>
+    using stored_t = std::tuple<std::remove_cvref_t<Args>...>;
+
+public:
+    using item_type = ct::args_t<Signature, stored_t>;
+
+    struct options_t {
+        /// the most events delivered by one handler
+        size_t max_batch = 256;
+        /// the longest an event waits for its batch to fill
+        std::chrono::steady_clock::duration max_delay = std::chrono::milliseconds(1);
+        /// of the lock-free buffer, it spills into a list under a mutex beyond
+        size_t capacity = 1024;
+    };
+
+    template <class Executor>
+    BatchEmitter(SignalType& sig, const Topic<Signature>& topic, const Executor& ex,
+                 options_t options = {})
+      : state_(std::make_shared<state_t>(sig, sig.resolve(topic), ex, options)) {
+        if (options.max_batch == 0) {
+            throw std::runtime_error("Expect: max_batch >= 1");
+        }
+    }
+
+    /// converted to the parameters of `Signature`, mismatched Args... do not compile
+    template <class... Args>
+    void emit(Args&&... args) {
+        auto& s = *state_;
+        // counted first, `pending` may run ahead of the buffer but never behind
+        size_t n = s.pending.fetch_add(1, std::memory_order_seq_cst) + 1;
+        s.items.push(item_type(std::forward<Args>(args)...));
+        if (!s.scheduled.exchange(true, std::memory_order_seq_cst)) {
+            boost::asio::post(s.strand, [self = state_] { kick(self); });
+        } else if (n == s.options.max_batch) {
+            // full, do not wait for the timer
+            boost::asio::post(s.strand, [self = state_] { flush(self); });
+        }
+    }
+
+    /// deliver the buffered events now
+    void flush() {
+        boost::asio::post(state_->strand, [self = state_] { flush(self); });
+    }
+
+    /// the events not yet delivered
+    inline size_t pending() const {
+        return state_->pending.load(std::memory_order_relaxed);
+    }
+
+    /// the batches delivered
+    inline uint64_t batches() const {
+        return state_->batches.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct state_t {
+        template <class Executor>
+        state_t(SignalType& sig, typename SignalType::template handle_t<Signature> h,
+                const Executor& ex, const options_t& options)
+          : sig(sig),
+            handle(h),
+            options(options),
+            strand(boost::asio::any_io_executor(ex)),
+            timer(strand),
+            items(options.capacity) {}
+
+        SignalType& sig;
+        const typename SignalType::template handle_t<Signature> handle;
+        const options_t options;
+
+        boost::asio::strand<boost::asio::any_io_executor> strand;
+        boost::asio::steady_timer timer;
+        detail::spill_queue<item_type> items;
+        std::atomic<size_t> pending{0};
+        // a kick, a timer or a flush is on its way
+        std::atomic<bool> scheduled{false};
+        std::atomic<uint64_t> batches{0};
+
+        // on the strand
+        bool armed = false;
+        std::vector<item_type> batch;
+    };
+
+    // on the strand: deliver a full batch now, or in `max_delay`
+    static void kick(const std::shared_ptr<state_t>& self) {
+        auto& s = *self;
+        if (s.pending.load(std::memory_order_seq_cst) >= s.options.max_batch) {
+            flush(self);
+            return;
+        }
+        arm(self);
+    }
+
+    // on the strand
+    static void arm(const std::shared_ptr<state_t>& self) {
+        auto& s = *self;
+        if (s.armed) {
+            return;
+        }
+        s.armed = true;
+        s.timer.expires_after(s.options.max_delay);
+        s.timer.async_wait([self](boost::system::error_code) {
+            self->armed = false;
+            flush(self);
+        });
+    }
+
+    // on the strand
+    static void flush(const std::shared_ptr<state_t>& self) {
+        auto& s = *self;
+        s.batch.clear();
+        size_t n = s.items.take(s.batch, s.options.max_batch);
+        s.pending.fetch_sub(n, std::memory_order_seq_cst);
+
+        // schedule the rest before delivering, a handler may throw
+        size_t rest = s.pending.load(std::memory_order_seq_cst);
+        if (rest >= s.options.max_batch) {
+            boost::asio::post(s.strand, [self] { flush(self); });
+        } else if (rest > 0) {
+            arm(self);
+        } else {
+            s.scheduled.store(false, std::memory_order_seq_cst);
+            // an event pushed after the take, whose producer saw `scheduled`
+            if (s.pending.load(std::memory_order_seq_cst) > 0
+                && !s.scheduled.exchange(true, std::memory_order_seq_cst)) {
+                arm(self);
+            } else if (s.armed) {
+                // drained, do not keep the io_context busy. The aborted wait still
+                // flushes, so an event racing with the cancel is not stranded.
+                s.timer.cancel();
+            }
+        }
+
+        if (n > 0) {
+            s.batches.fetch_add(1, std::memory_order_relaxed);
+            s.sig.emit_all(s.handle, s.batch);
+        }
+    }
+
+private:
+    std::shared_ptr<state_t> state_;
+};
+
+template <class SignalType, class Signature, class Executor>
+BatchEmitter(SignalType&, const Topic<Signature>&, const Executor&)
+    -> BatchEmitter<SignalType, Signature>;
+
+template <class SignalType, class Signature, class Executor>
+BatchEmitter(SignalType&, const Topic<Signature>&, const Executor&,
+             typename BatchEmitter<SignalType, Signature>::options_t)
+    -> BatchEmitter<SignalType, Signature>;
+
+}  // namespace ccl2
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <ccl2/function.h>
+#include <ccl2/ring_buffer.h>
+#include <ccl2/signal.h>
+#include <ccl2/topic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+//!
+//! A handler of Signal running on its own executor.
+//!
+//! The handler registered in the signal only copies the arguments into a bounded
+//! lock-free queue, the emitter never runs the subscriber's code. The events are
+//! delivered in order on a strand of `executor`, at most `max_batch` per handler
+//! posted so that one busy subscriber does not hog a shared executor.
+//!
+//!     static const ccl2::Topic<void(int, double)> kSensor{"/sensor/*"};
+//!     ccl2::AsyncSubscriber sub(sig, kSensor, pool.get_executor(), on_sensor);
+//!     sig.emit("/sensor/17", 1, 2.0);   // enqueued
+//!     sub.metrics().lag;                // how far behind the subscriber is
+//!
+//! A full queue drops an event, the newest or the oldest as `overflow` says. The
+//! destructor removes the handler from the signal, which must outlive the subscriber,
+//! and drops the events still queued. It waits for an event being delivered on
+//! another thread, `f` is not called once it returns.
+//!
+template <class SignalType, class Signature>
+class AsyncSubscriber : boost::noncopyable {
+    template <class... Args>
+    using stored_t = std::tuple<std::remove_cvref_t<Args>...>;
+
+    using clock = std::chrono::steady_clock;
+
+public:
+    using item_type = ct::args_t<Signature, stored_t>;
+
+    enum class overflow_t {
+        drop_newest,
+        drop_oldest,
+    };
+
+    struct options_t {
+        /// of the queue, rounded up to a power of 2
+        size_t capacity     = 1024;
+        overflow_t overflow = overflow_t::drop_newest;
+        /// the most events delivered by one handler posted to the executor. If the
+        /// handler throws, the rest of them are lost.
+        size_t max_batch = 64;
+    };
+
+    struct metrics_t {
+        /// the events waiting in the queue
+        size_t queued      = 0;
+        uint64_t delivered = 0;
+        uint64_t dropped   = 0;
+        /// from the emit to the delivery, of the last event delivered
+        std::chrono::nanoseconds lag{0};
+        std::chrono::nanoseconds max_lag{0};
+    };
+
+    template <class Executor, class F>
+    AsyncSubscriber(SignalType& sig, const Topic<Signature>& topic, const Executor& ex,
+                    F&& f, options_t options = {})
+      : sig_(sig),
+        state_(std::make_shared<state_t>(
+            ex, ccl2::bind.template operator()<Signature>(std::forward<F>(f)),
+            options)) {
+        if (options.max_batch == 0) {
+            throw std::runtime_error("Expect: max_batch >= 1");
+        }
+        sub_ = sig.template register_handler2<Signature>(
+            topic.name(), [self = state_](const auto&... args) {
+                push(self, item_type(args...));
+            });
+    }
+
+    ~AsyncSubscriber() {
+        sig_.remove(sub_);
+        // an emit started before may still push, it is dropped
+        state_->closed.store(true, std::memory_order_release);
+        // from the handler itself, the batch stops after it
+        if (!state_->strand.running_in_this_thread()) {
+            std::lock_guard<std::mutex> _lck{state_->delivering};
+        }
+    }
+
+    metrics_t metrics() const {
+        const auto& s = *state_;
+        metrics_t r;
+        r.queued    = s.queued.load(std::memory_order_relaxed);
+        r.delivered = s.delivered.load(std::memory_order_relaxed);
+        r.dropped   = s.dropped.load(std::memory_order_relaxed);
+        r.lag       = std::chrono::nanoseconds(s.lag_ns.load(std::memory_order_relaxed));
+        r.max_lag =
+            std::chrono::nanoseconds(s.max_lag_ns.load(std::memory_order_relaxed));
+        return r;
+    }
+
+private:
+    struct entry_t {
+        item_type item;
+        clock::time_point at;
+    };
+
+    struct state_t {
+        template <class Executor>
+        state_t(const Executor& ex, ccl2::function<void>&& f, const options_t& options)
+          : f(std::move(f)),
+            options(options),
+            strand(boost::asio::any_io_executor(ex)),
+            items(options.capacity) {}
+
+        const ccl2::function<void> f;
+        const options_t options;
+        boost::asio::strand<boost::asio::any_io_executor> strand;
+        detail::ring_buffer<entry_t> items;
+
+        std::atomic<bool> closed{false};
+        // may run ahead of the queue but never behind
+        std::atomic<size_t> queued{0};
+        // a drain is on its way
+        std::atomic<bool> scheduled{false};
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<int64_t> lag_ns{0};
+        std::atomic<int64_t> max_lag_ns{0};
+
+        // on the strand
+        std::vector<entry_t> batch;
+        // held while a batch is delivered, the destructor waits for it
+        std::mutex delivering;
+    };
+
+    // on the emitter's thread
+    static void push(const std::shared_ptr<state_t>& self, item_type&& item) {
+        auto& s = *self;
+        if (s.closed.load(std::memory_order_acquire)) {
+            return;
+        }
+        entry_t e{std::move(item), clock::now()};
+        s.queued.fetch_add(1, std::memory_order_seq_cst);
+        if (s.options.overflow == overflow_t::drop_newest) {
+            if (!s.items.try_push(std::move(e))) {
+                s.queued.fetch_sub(1, std::memory_order_relaxed);
+                s.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        } else {
+            // `e` is moved only on success
+            while (!s.items.try_push(std::move(e))) {
+                if (s.items.try_pop()) {
+                    s.queued.fetch_sub(1, std::memory_order_relaxed);
+                    s.dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+        if (!s.scheduled.exchange(true, std::memory_order_seq_cst)) {
+            boost::asio::post(s.strand, [self] { drain(self); });
+        }
+    }
+
+    // on the strand
+    static void drain(const std::shared_ptr<state_t>& self) {
+        auto& s = *self;
+        s.batch.clear();
+        while (s.batch.size() < s.options.max_batch) {
+            auto e = s.items.try_pop();
+            if (!e) {
+                break;
+            }
+            s.batch.emplace_back(std::move(*e));
+        }
+        s.queued.fetch_sub(s.batch.size(), std::memory_order_seq_cst);
+
+        // schedule the rest before delivering, a handler may throw
+        if (s.queued.load(std::memory_order_seq_cst) > 0) {
+            boost::asio::post(s.strand, [self] { drain(self); });
+        } else {
+            s.scheduled.store(false, std::memory_order_seq_cst);
+            // an event pushed after the last pop, whose producer saw `scheduled`
+            if (s.queued.load(std::memory_order_seq_cst) > 0
+                && !s.scheduled.exchange(true, std::memory_order_seq_cst)) {
+                boost::asio::post(s.strand, [self] { drain(self); });
+            }
+        }
+
+        std::lock_guard<std::mutex> _lck{s.delivering};
+        for (auto& e : s.batch) {
+            if (s.closed.load(std::memory_order_acquire)) {
+                return;
+            }
+            int64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              clock::now() - e.at)
+                              .count();
+            s.lag_ns.store(lag, std::memory_order_relaxed);
+            if (lag > s.max_lag_ns.load(std::memory_order_relaxed)) {
+                s.max_lag_ns.store(lag, std::memory_order_relaxed);
+            }
+            s.delivered.fetch_add(1, std::memory_order_relaxed);
+            std::apply(
+                [&](auto&... args) {
+                    ccl2::invoke(with_signature<Signature>, s.f, std::move(args)...);
+                },
+                e.item);
+        }
+    }
+
+private:
+    SignalType& sig_;
+    std::shared_ptr<state_t> state_;
+    typename SignalType::subscription_t sub_;
+};
+
+template <class SignalType, class Signature, class Executor, class F>
+AsyncSubscriber(SignalType&, const Topic<Signature>&, const Executor&, F&&)
+    -> AsyncSubscriber<SignalType, Signature>;
+
+template <class SignalType, class Signature, class Executor, class F>
+AsyncSubscriber(SignalType&, const Topic<Signature>&, const Executor&, F&&,
+                typename AsyncSubscriber<SignalType, Signature>::options_t)
+    -> AsyncSubscriber<SignalType, Signature>;
+
+}  // namespace ccl2
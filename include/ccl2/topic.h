@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+namespace detail {
+
+// where a Signal interned a Topic: the id of the signal in the high 32 bits, the
+// index of the topic in the low ones, 0 if none
+struct topic_slot {
+    topic_slot() = default;
+    topic_slot(const topic_slot& other) noexcept
+      : value(other.value.load(std::memory_order_relaxed)) {}
+    topic_slot& operator=(const topic_slot& other) noexcept {
+        value.store(other.value.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        return *this;
+    }
+
+    std::atomic<uint64_t> value{0};
+};
+
+}  // namespace detail
+
+//!
+//! A topic of Signal or a name of Service, typed with its signature.
+//!
+//!     static const ccl2::Topic<void(int, int)> kVel{"vel"};
+//!     signal.register_handler(kVel, on_vel);
+//!     signal.emit(kVel, 1, 2);   // emit(kVel, "1") does not compile
+//!
+//! The arguments are converted to the parameters at compile time, and the name is
+//! hashed once on construction instead of on every call. The first emit on a Signal
+//! interns the topic and caches its index in the Topic, the next emits on that
+//! signal do no lookup, like a handle from `Signal::resolve()`. A Topic emitted on
+//! several signals in turn keeps only the index of the last one.
+//!
+template <class Signature>
+class Topic {
+public:
+    using signature = Signature;
+
+    explicit Topic(std::string_view name)
+      : name_(name), hash_(std::hash<std::string_view>{}(name)) {}
+
+    inline const std::string& name() const noexcept { return name_; }
+
+    inline size_t hash() const noexcept { return hash_; }
+
+    /// used by Signal
+    inline detail::topic_slot& slot() const noexcept { return slot_; }
+
+private:
+    std::string name_;
+    size_t hash_;
+    mutable detail::topic_slot slot_;
+};
+
+namespace detail {
+
+inline std::string_view topic_name(std::string_view name) noexcept {
+    return name;
+}
+
+template <class Signature>
+std::string_view topic_name(const Topic<Signature>& topic) noexcept {
+    return topic.name();
+}
+
+//
+// Path-like topics, the levels are separated by '/'. In a pattern `*` matches one
+// level, and `#` as the last level matches any number of levels, zero included:
+//     "/sensor/*/temp"  matches "/sensor/17/temp"
+//     "/sensor/#"       matches "/sensor", "/sensor/17", "/sensor/17/temp"
+//
+inline std::vector<std::string_view> topic_levels(std::string_view topic) {
+    std::vector<std::string_view> r;
+    for (;;) {
+        auto pos = topic.find('/');
+        r.emplace_back(topic.substr(0, pos));
+        if (pos == std::string_view::npos) {
+            return r;
+        }
+        topic.remove_prefix(pos + 1);
+    }
+}
+
+/// throws std::runtime_error if `#` is not the last level
+inline bool is_topic_pattern(std::string_view topic) {
+    auto levels = topic_levels(topic);
+    bool r      = false;
+    for (size_t i = 0; i < levels.size(); i++) {
+        if (levels[i] == "#" && i + 1 != levels.size()) {
+            throw std::runtime_error("Expect: # is the last level, "
+                                     + std::string(topic));
+        }
+        r = r || levels[i] == "*" || levels[i] == "#";
+    }
+    return r;
+}
+
+inline bool topic_match(std::string_view pattern, std::string_view topic) {
+    auto p = topic_levels(pattern);
+    auto t = topic_levels(topic);
+    for (size_t i = 0; i < p.size(); i++) {
+        if (p[i] == "#") {
+            return true;
+        }
+        if (i >= t.size() || (p[i] != "*" && p[i] != t[i])) {
+            return false;
+        }
+    }
+    return p.size() == t.size();
+}
+
+// transparent, look up a registry keyed by std::string with a string_view or a Topic
+struct topic_hash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view name) const noexcept {
+        return std::hash<std::string_view>{}(name);
+    }
+
+    template <class Signature>
+    size_t operator()(const Topic<Signature>& topic) const noexcept {
+        return topic.hash();
+    }
+};
+
+struct topic_equal {
+    using is_transparent = void;
+
+    template <class A, class B>
+    bool operator()(const A& a, const B& b) const noexcept {
+        return topic_name(a) == topic_name(b);
+    }
+};
+
+}  // namespace detail
+
+}  // namespace ccl2
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ccl2 {
+
+namespace detail {
+
+struct ws_task {
+    virtual ~ws_task() = default;
+    virtual void run() = 0;
+};
+
+template <class F>
+struct ws_task_impl final : ws_task {
+    explicit ws_task_impl(F&& f) : f_(std::move(f)) {}
+    void run() override { f_(); }
+    F f_;
+};
+
+//!
+//! Chase-Lev work-stealing deque
+//!     refer: "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP'13
+//!
+//! push/pop by the owner thread (LIFO), steal by any other thread (FIFO).
+//!
+class ChaseLevDeque : boost::noncopyable {
+    struct ring_t {
+        explicit ring_t(int64_t cap) : cap_(cap), buf_(new std::atomic<ws_task*>[cap]) {}
+
+        int64_t capacity() const { return cap_; }
+        ws_task* get(int64_t i) const {
+            return buf_[i & (cap_ - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, ws_task* t) {
+            buf_[i & (cap_ - 1)].store(t, std::memory_order_relaxed);
+        }
+
+        ring_t* grow(int64_t bottom, int64_t top) const {
+            auto* r = new ring_t(cap_ * 2);
+            for (int64_t i = top; i < bottom; i++) {
+                r->put(i, get(i));
+            }
+            return r;
+        }
+
+        const int64_t cap_;
+        std::unique_ptr<std::atomic<ws_task*>[]> buf_;
+    };
+
+public:
+    explicit ChaseLevDeque(int64_t cap = 256) : top_(0), bottom_(0) {
+        if (cap <= 0 || (cap & (cap - 1)) != 0) {
+            throw std::runtime_error("Expect: cap is a power of 2");
+        }
+        auto* r = new ring_t(cap);
+        rings_.emplace_back(r);
+        ring_.store(r, std::memory_order_relaxed);
+    }
+
+    void push(ws_task* t) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t x = top_.load(std::memory_order_acquire);
+        ring_t* r = ring_.load(std::memory_order_relaxed);
+        if (b - x > r->capacity() - 1) {
+            // old rings may still be read by thieves, free them on destruction
+            r = r->grow(b, x);
+            rings_.emplace_back(r);
+            ring_.store(r, std::memory_order_release);
+        }
+        r->put(b, t);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    ws_task* pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        ring_t* r = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t x = top_.load(std::memory_order_relaxed);
+
+        ws_task* t = nullptr;
+        if (x <= b) {
+            t = r->get(b);
+            if (x == b) {
+                // the last one, race with thieves
+                if (!top_.compare_exchange_strong(
+                        x, x + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    t = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+    ws_task* steal() {
+        int64_t x = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (x < b) {
+            ring_t* r  = ring_.load(std::memory_order_acquire);
+            ws_task* t = r->get(x);
+            if (!top_.compare_exchange_strong(
+                    x, x + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return t;
+        }
+        return nullptr;
+    }
+
+    bool empty() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t x = top_.load(std::memory_order_relaxed);
+        return b <= x;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    std::atomic<ring_t*> ring_;
+    std::vector<std::unique_ptr<ring_t>> rings_;
+};
+
+}  // namespace detail
+
+//!
+//! Thread pool for compute-bound tasks.
+//!
+//! Each worker owns a Chase-Lev deque, tasks submitted from a worker go to its own
+//! deque, tasks from other threads go to a global injection queue. Idle workers
+//! steal from each other before going to sleep.
+//!
+//! `executor_type` is an asio standard executor, so it works with `asio::post`,
+//! `asio::co_spawn` and `asio::any_io_executor`.
+//!
+//! A task that throws does not stop its worker, the first exception is rethrown by
+//! `join()`. co_spawn passes the exceptions of a coroutine to its completion instead.
+//!
+//! The pool must not be joined or destroyed by one of its own tasks, `join()` throws
+//! and the destructor terminates. Hand it to a thread the pool does not own instead.
+//!
+class WorkStealingPool final : public boost::asio::execution_context,
+                               boost::noncopyable {
+public:
+    class executor_type;
+
+    /// @param num: the number of worker threads.
+    explicit WorkStealingPool(size_t num = std::thread::hardware_concurrency())
+      : stopped_(false), pending_(0), idle_(0) {
+        if (num <= 0) {
+            throw std::runtime_error("Expect: num >= 1");
+        }
+
+        queues_.reserve(num);
+        for (size_t i = 0; i < num; i++) {
+            queues_.emplace_back(std::make_unique<detail::ChaseLevDeque>());
+        }
+        threads_.reserve(num);
+        for (size_t i = 0; i < num; i++) {
+            threads_.emplace_back([this, i] { worker(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        shutdown();
+        join_threads();
+
+        // drop the tasks never run
+        for (size_t i = 0; i < queues_.size(); i++) {
+            while (auto* t = take(i)) {
+                delete t;
+            }
+        }
+        boost::asio::execution_context::shutdown();
+        boost::asio::execution_context::destroy();
+    }
+
+    inline executor_type get_executor() noexcept;
+
+    template <class CompletionToken>
+    auto enqueue(CompletionToken&& token);
+
+    inline size_t worker_count() const { return queues_.size(); }
+
+    /// the number of tasks queued but not yet started
+    inline size_t pending() const { return pending_.load(std::memory_order_relaxed); }
+
+    /// stop the workers, the queued tasks are abandoned.
+    void shutdown() {
+        if (!stopped_.exchange(true, std::memory_order_acq_rel)) {
+            std::lock_guard _lck{sleep_mtx_};
+            sleep_cv_.notify_all();
+        }
+    }
+
+    /// wait for the workers to stop, then rethrow the first exception a task threw,
+    /// the others are dropped
+    void join() {
+        join_threads();
+
+        std::exception_ptr eptr;
+        {
+            std::lock_guard _lck{error_mtx_};
+            std::swap(eptr, error_);
+        }
+        if (eptr) {
+            std::rethrow_exception(eptr);
+        }
+    }
+
+    bool running_in_this_thread() const noexcept { return current().pool == this; }
+
+private:
+    struct worker_info_t {
+        const WorkStealingPool* pool = nullptr;
+        size_t index                 = 0;
+    };
+
+    static worker_info_t& current() {
+        static thread_local worker_info_t info;
+        return info;
+    }
+
+    template <class F>
+    void submit(F&& f) {
+        using DF = std::decay_t<F>;
+        auto* t  = new detail::ws_task_impl<DF>(DF(std::forward<F>(f)));
+
+        // count it before publishing, so `pending_` never goes below zero
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        auto& info = current();
+        if (info.pool == this) {
+            queues_[info.index]->push(t);
+        } else {
+            std::lock_guard _lck{inject_mtx_};
+            inject_.push_back(t);
+        }
+
+        // pairs with the fence in `worker()`, either the task is seen by a worker
+        // going to sleep or that worker is seen idle
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (idle_.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard _lck{sleep_mtx_};
+            sleep_cv_.notify_one();
+        }
+    }
+
+    void join_threads() {
+        // a worker would outlive the pool it reads
+        if (running_in_this_thread()) {
+            throw std::runtime_error("Expect: the pool joined outside of its workers");
+        }
+        for (auto& th : threads_) {
+            if (th.joinable()) {
+                th.join();
+            }
+        }
+    }
+
+    /// @return: true if a task is queued, another worker may take it meanwhile
+    bool has_task() {
+        for (auto& q : queues_) {
+            if (!q->empty()) {
+                return true;
+            }
+        }
+        std::lock_guard _lck{inject_mtx_};
+        return !inject_.empty();
+    }
+
+    detail::ws_task* take(size_t index) {
+        // 1. own deque
+        if (auto* t = queues_[index]->pop()) {
+            return t;
+        }
+
+        // 2. global injection queue
+        {
+            std::lock_guard _lck{inject_mtx_};
+            if (!inject_.empty()) {
+                auto* t = inject_.front();
+                inject_.pop_front();
+                return t;
+            }
+        }
+
+        // 3. steal from others, starting at a random victim
+        const size_t n = queues_.size();
+        thread_local std::minstd_rand rng{std::random_device{}()};
+        size_t start = rng() % n;
+        for (size_t i = 0; i < n; i++) {
+            size_t victim = (start + i) % n;
+            if (victim == index) {
+                continue;
+            }
+            if (auto* t = queues_[victim]->steal()) {
+                return t;
+            }
+        }
+        return nullptr;
+    }
+
+    void worker(size_t index) {
+        current() = worker_info_t{this, index};
+
+        while (!stopped_.load(std::memory_order_acquire)) {
+            if (auto* t = take(index)) {
+                pending_.fetch_sub(1, std::memory_order_relaxed);
+                std::unique_ptr<detail::ws_task> guard(t);
+                try {
+                    t->run();
+                } catch (...) {
+                    std::lock_guard _lck{error_mtx_};
+                    if (!error_) {
+                        error_ = std::current_exception();
+                    }
+                }
+                continue;
+            }
+
+            // re-check the queues rather than `pending_`, which is counted before the
+            // task is published and would spin the worker until it is
+            std::unique_lock _lck{sleep_mtx_};
+            idle_.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            sleep_cv_.wait(_lck, [this] {
+                return stopped_.load(std::memory_order_relaxed) || has_task();
+            });
+            idle_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        current() = worker_info_t{};
+    }
+
+private:
+    std::atomic<bool> stopped_;
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> idle_;
+
+    std::vector<std::unique_ptr<detail::ChaseLevDeque>> queues_;
+
+    std::mutex inject_mtx_;
+    std::deque<detail::ws_task*> inject_;
+
+    std::mutex sleep_mtx_;
+    std::condition_variable sleep_cv_;
+
+    // the first exception thrown by a task, for join()
+    std::mutex error_mtx_;
+    std::exception_ptr error_;
+
+    std::vector<std::thread> threads_;
+};
+
+class WorkStealingPool::executor_type {
+public:
+    explicit executor_type(WorkStealingPool& pool) noexcept : pool_(&pool) {}
+
+    WorkStealingPool& query(boost::asio::execution::context_t) const noexcept {
+        return *pool_;
+    }
+
+    static constexpr boost::asio::execution::blocking_t
+    query(boost::asio::execution::blocking_t) noexcept {
+        return boost::asio::execution::blocking.never;
+    }
+
+    executor_type require(boost::asio::execution::blocking_t::never_t) const noexcept {
+        return *this;
+    }
+
+    template <class F>
+    void execute(F&& f) const {
+        pool_->submit(std::forward<F>(f));
+    }
+
+    bool running_in_this_thread() const noexcept {
+        return pool_->running_in_this_thread();
+    }
+
+    friend bool operator==(const executor_type& a, const executor_type& b) noexcept {
+        return a.pool_ == b.pool_;
+    }
+
+    friend bool operator!=(const executor_type& a, const executor_type& b) noexcept {
+        return a.pool_ != b.pool_;
+    }
+
+private:
+    WorkStealingPool* pool_;
+};
+
+inline WorkStealingPool::executor_type WorkStealingPool::get_executor() noexcept {
+    return executor_type(*this);
+}
+
+template <class CompletionToken>
+auto WorkStealingPool::enqueue(CompletionToken&& token) {
+    return boost::asio::post(get_executor(), std::forward<CompletionToken>(token));
+}
+
+}  // namespace ccl2
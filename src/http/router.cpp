@@ -207,6 +207,17 @@ Router::bad_request(const Router::request_type& req, std::string_view why) {
     return res;
 }
 
+Router::response_type Router::service_unavailable(const Router::request_type& req) {
+    http::response<http::string_body> res{http::status::service_unavailable,
+                                          req.version()};
+    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    res.set(http::field::content_type, "text/html");
+    res.keep_alive(req.keep_alive());
+    res.body() = "The server is busy, try again later.";
+    res.prepare_payload();
+    return res;
+}
+
 }  // namespace ccl2
 
 #endif
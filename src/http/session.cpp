@@ -1,10 +1,14 @@
 #ifdef CCL2_USE_COROUTINES
 
 #    include "ccl2/http/session.h"
+#    include "ccl2/blocking_pool.h"
 #    include "ccl2/http/mime_types.h"
 #    include "ccl2/http/router.h"
 #    include <algorithm>
+#    include <cstdint>
 #    include <iostream>
+#    include <optional>
+#    include <stdexcept>
 #    include <vector>
 #    include <boost/asio.hpp>
 #    include <boost/beast.hpp>
@@ -58,7 +62,10 @@ class HttpServer::Impl {
 public:
     using static_file_routes_t = std::map<std::string, std::string>;
 
-    Impl(HttpServer::options_t options) : options_(std::move(options)) {}
+    Impl(HttpServer::options_t options)
+      : options_(std::move(options))
+      , blocking_(options_.blocking_threads > 0 ? options_.blocking_threads : 16,
+                  options_.blocking_queue) {}
 
     Router& router() { return router_; }
 
@@ -104,11 +111,24 @@ private:
                && content_type.starts_with("multipart/form-data");
     }
 
-    static Router::response_type static_file_handler(Router::request_type&& req,
-                                                     std::string path,
-                                                     std::string doc_root) {
+    // A static file opened on the blocking pool, or the reply when there is no body
+    // to stream: an error or a HEAD request.
+    struct static_file_t {
+        std::optional<Router::response_type> reply;
+        beast::file file;
+        std::uint64_t size = 0;
+        std::string_view mime;
+    };
+
+    // the bytes read per job on the blocking pool, and written per async_write
+    static constexpr size_t kFileChunk = 64 * 1024;
+
+    static static_file_t open_static_file(const Router::request_type& req,
+                                          std::string path, std::string doc_root) {
+        static_file_t r;
         if (!path.empty() && (path[0] != '/' || path.find("..") != std::string::npos)) {
-            return Router::bad_request(req, "Illegal request-target");
+            r.reply.emplace(Router::bad_request(req, "Illegal request-target"));
+            return r;
         }
 
         path = path_cat(doc_root, path);
@@ -117,42 +137,116 @@ private:
         }
 
         beast::error_code ec;
-        http::file_body::value_type body;
-        body.open(path.c_str(), beast::file_mode::scan, ec);
+        r.file.open(path.c_str(), beast::file_mode::scan, ec);
 
         // Handle the case where the file doesn't exist
         if (ec == beast::errc::no_such_file_or_directory) {
-            return Router::not_found(req);
+            r.reply.emplace(Router::not_found(req));
+            return r;
         }
 
         if (ec) {
-            return Router::server_error(req, ec.message());
+            r.reply.emplace(Router::server_error(req, ec.message()));
+            return r;
         }
 
-        // Cache the size since we need it after the move
-        auto const size = body.size();
+        r.size = r.file.size(ec);
+        if (ec) {
+            r.reply.emplace(Router::server_error(req, ec.message()));
+            return r;
+        }
+        r.mime = mime_type(path);
 
         // Respond to HEAD request
         if (req.method() == http::verb::head) {
             http::response<http::empty_body> res{http::status::ok, req.version()};
             res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-            res.set(http::field::content_type, mime_type(path));
-            res.content_length(size);
+            res.set(http::field::content_type, r.mime);
+            res.content_length(r.size);
             res.keep_alive(req.keep_alive());
-            return res;
+            r.reply.emplace(std::move(res));
+        }
+        return r;
+    }
+
+    // Returns whether to keep the connection alive.
+    static asio::task<bool> send(tcp_stream& stream, Router::response_type&& msg) {
+        bool keep_alive = msg.keep_alive();
+        co_await beast::async_write(stream, std::move(msg), asio::use_awaitable);
+        co_return keep_alive;
+    }
+
+    // Sends a static file by chunks of kFileChunk, each read on the blocking pool and
+    // written from the io thread, a file is never held in memory whole. Returns
+    // whether to keep the connection alive.
+    asio::task<bool> send_static_file(tcp_stream& stream, Router::request_type req,
+                                      std::string path, const std::string& doc_root) {
+        std::optional<static_file_t> f;
+        std::optional<std::string> what;
+        try {
+            f.emplace(co_await ccl2::offload(
+                blocking_, [&] { return open_static_file(req, std::move(path), doc_root); }));
+        } catch (const ccl2::pool_full_error&) {
+            // shed the request
+        } catch (const std::exception& e) {
+            what = e.what();
+        }
+        if (what) {
+            co_return co_await send(stream, Router::server_error(req, *what));
+        }
+        if (!f) {
+            co_return co_await send(stream, Router::service_unavailable(req));
+        }
+        if (f->reply) {
+            co_return co_await send(stream, std::move(*f->reply));
         }
+
         // Respond to GET request
-        else {
-            http::response<http::file_body> res{std::piecewise_construct,
-                                                std::make_tuple(std::move(body)),
-                                                std::make_tuple(http::status::ok,
-                                                                req.version())};
-            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-            res.set(http::field::content_type, mime_type(path));
-            res.content_length(size);
-            res.keep_alive(req.keep_alive());
-            return res;
+        http::response<http::buffer_body> res{http::status::ok, req.version()};
+        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res.set(http::field::content_type, f->mime);
+        res.content_length(f->size);
+        res.keep_alive(req.keep_alive());
+        res.body().data = nullptr;
+        res.body().more = f->size > 0;
+
+        http::response_serializer<http::buffer_body> sr{res};
+        co_await http::async_write_header(stream, sr);
+
+        // The header is out, an error from here on (a short read, a full pool) can
+        // only drop the connection.
+        std::vector<char> chunk(std::min<std::uint64_t>(f->size, kFileChunk));
+        std::uint64_t left = f->size;
+        while (left > 0) {
+            beast::error_code ec;
+            size_t n = co_await ccl2::offload(blocking_, [&] {
+                return f->file.read(chunk.data(),
+                                    std::min<std::uint64_t>(left, chunk.size()), ec);
+            });
+            if (!ec && n == 0) {
+                ec = http::error::partial_message;
+            }
+            if (ec) {
+                throw boost::system::system_error(ec);
+            }
+            left -= n;
+
+            res.body().data = chunk.data();
+            res.body().size = n;
+            res.body().more = left > 0;
+            try {
+                co_await http::async_write(stream, sr);
+            } catch (const boost::system::system_error& se) {
+                // the chunk is written, the serializer wants the next one
+                if (se.code() != http::error::need_buffer) {
+                    throw;
+                }
+            }
+        }
+        if (!sr.is_done()) {
+            co_await http::async_write(stream, sr);
         }
+        co_return res.keep_alive();
     }
 
     // Handles an HTTP server connection
@@ -198,23 +292,17 @@ private:
                             return requri.starts_with(prefix);
                         });
 
-                    std::shared_ptr<Router::response_type> msg = nullptr;
+                    bool keep_alive = true;
                     if (iter != routes.end()) {
-                        auto path = requri.substr(iter->first.size());
-                        msg = std::make_shared<Router::response_type>(static_file_handler(
-                            parser.release(), std::string(path), iter->second));
+                        // file I/O, keep it off the io threads
+                        auto path = std::string(requri.substr(iter->first.size()));
+                        keep_alive = co_await send_static_file(
+                            stream, parser.release(), std::move(path), iter->second);
                     } else {
-                        msg = std::make_shared<Router::response_type>(
-                            co_await router_.handle_request(parser.release()));
+                        keep_alive = co_await send(
+                            stream, co_await router_.handle_request(parser.release()));
                     }
 
-                    // Determine if we should close the connection
-                    assert(msg != nullptr);
-                    bool keep_alive = msg->keep_alive();
-
-                    co_await beast::async_write(
-                        stream, std::move(*msg), asio::use_awaitable);
-
                     if (!keep_alive) {
                         // This means we should close the connection, usually because
                         // the response indicated the "Connection: close" semantic.
@@ -244,6 +332,8 @@ private:
 private:
     Router router_;
     const HttpServer::options_t options_;
+    // reads the static files
+    BlockingPool blocking_;
     static_file_routes_t static_file_routes_;
 };
 
@@ -0,0 +1,432 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <ccl2/asio_pool.h>
+#include <ccl2/stopwatch.h>
+#include <gtest/gtest.h>
+
+TEST(AsioPool, shared) {
+    ccl2::AsioPool pool(2);
+    EXPECT_EQ(pool.shard_count(), 1u);
+    EXPECT_EQ(&pool.get_io_context(), &pool.get_io_context());
+
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        pool.enqueue([&] {
+            if (++cnt == 100) {
+                pool.shutdown();
+            }
+        });
+    }
+    pool.run();
+    EXPECT_EQ(cnt.load(), 100);
+}
+
+TEST(AsioPool, sharded) {
+    ccl2::AsioPool pool(4, ccl2::AsioPool::mode_t::sharded);
+    EXPECT_EQ(pool.shard_count(), 4u);
+    EXPECT_NE(&pool.get_io_context(), &pool.get_io_context());
+    EXPECT_EQ(&pool.get_io_context(42), &pool.get_io_context(42));
+
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        // all handlers of the same key run on the same thread
+        pool.enqueue(7, [&] {
+            EXPECT_EQ(pool.this_io_context(), &pool.get_io_context(7));
+            {
+                std::lock_guard _lck{mtx};
+                threads.insert(std::this_thread::get_id());
+            }
+            if (++cnt == 100) {
+                pool.shutdown();
+            }
+        });
+    }
+    pool.run();
+    EXPECT_EQ(cnt.load(), 100);
+    EXPECT_EQ(threads.size(), 1u);
+    EXPECT_EQ(pool.this_io_context(), nullptr);
+}
+
+TEST(AsioPool, compute) {
+    ccl2::AsioPool pool(2);
+    auto ex = pool.get_compute_executor();
+
+    std::atomic<int> cnt = 0;
+    constexpr int total  = 10000;
+    for (int i = 0; i < 100; i++) {
+        pool.enqueue_compute([&, ex] {
+            EXPECT_TRUE(ex.running_in_this_thread());
+            // fan-out from a worker goes to its own deque and gets stolen
+            for (int j = 0; j < total / 100; j++) {
+                boost::asio::post(ex, [&] {
+                    if (++cnt == total) {
+                        pool.shutdown();
+                    }
+                });
+            }
+        });
+    }
+    pool.run();
+    EXPECT_EQ(cnt.load(), total);
+}
+
+TEST(AsioPool, compute_co_spawn) {
+    ccl2::AsioPool pool(1);
+    auto ex = pool.get_compute_executor();
+
+    int result = 0;
+    boost::asio::co_spawn(
+        ex,
+        [ex]() -> boost::asio::awaitable<int> {
+            EXPECT_TRUE(ex.running_in_this_thread());
+            co_return 42;
+        },
+        // complete on the io thread
+        boost::asio::bind_executor(pool.get_io_context(),
+                                   [&](std::exception_ptr e, int r) {
+                                       EXPECT_TRUE(!e);
+                                       result = r;
+                                       pool.shutdown();
+                                   }));
+    pool.run();
+    EXPECT_EQ(result, 42);
+}
+
+TEST(WorkStealingPool, throws) {
+    ccl2::WorkStealingPool pool(2);
+
+    // the workers keep running, join() rethrows the first exception
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        pool.enqueue([&, i] {
+            cnt++;
+            if (i % 10 == 0) {
+                throw std::runtime_error("task " + std::to_string(i));
+            }
+        });
+    }
+    while (cnt.load() < 100) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pool.shutdown();
+    EXPECT_THROW(pool.join(), std::runtime_error);
+    EXPECT_NO_THROW(pool.join());
+}
+
+TEST(WorkStealingPool, join_from_task) {
+    ccl2::WorkStealingPool pool(2);
+
+    // a worker can not wait for itself
+    std::atomic<bool> refused = false;
+    pool.enqueue([&] {
+        EXPECT_THROW(pool.join(), std::runtime_error);
+        refused = true;
+    });
+    while (!refused.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    pool.shutdown();
+    EXPECT_NO_THROW(pool.join());
+}
+
+#ifdef __linux__
+TEST(AsioPool, affinity) {
+    // the first cpu allowed, cpu 0 may be excluded by taskset or a cpuset
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    int cpu = 0;
+    while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed)) {
+        cpu++;
+    }
+    if (cpu == CPU_SETSIZE) {
+        GTEST_SKIP() << "no cpu allowed";
+    }
+
+    ccl2::AsioPool::options_t options;
+    options.num  = 2;
+    options.cpus = {cpu};
+    options.name = "ccl2-test";
+    ccl2::AsioPool pool(options);
+
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 2; i++) {
+        pool.enqueue([&] {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            EXPECT_EQ(sched_getaffinity(0, sizeof(cpuset), &cpuset), 0);
+            EXPECT_EQ(CPU_COUNT(&cpuset), 1);
+            EXPECT_TRUE(CPU_ISSET(cpu, &cpuset));
+
+            char name[16] = {0};
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            EXPECT_EQ(std::string(name).rfind("ccl2-test-", 0), 0u);
+
+            if (++cnt == 2) {
+                pool.shutdown();
+            }
+        });
+    }
+
+    // run() pins the calling thread too, and restores it on return
+    cpu_set_t before;
+    CPU_ZERO(&before);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(before), &before), 0);
+    char name[16] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+
+    pool.run();
+    EXPECT_EQ(cnt.load(), 2);
+    EXPECT_EQ(pool.setup_failures(), 0u);
+
+    cpu_set_t after;
+    CPU_ZERO(&after);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+    char name_after[16] = {0};
+    pthread_getname_np(pthread_self(), name_after, sizeof(name_after));
+    EXPECT_STREQ(name, name_after);
+}
+
+TEST(AsioPool, numa_local) {
+    int mode = 0;
+    if (syscall(SYS_get_mempolicy, &mode, nullptr, 0, nullptr, 0) != 0) {
+        GTEST_SKIP() << "get_mempolicy is not available";
+    }
+
+    ccl2::AsioPool::options_t options;
+    options.num        = 2;
+    options.numa_local = true;
+    ccl2::AsioPool pool(options);
+
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 2; i++) {
+        pool.enqueue([&] {
+            if (++cnt == 2) {
+                pool.shutdown();
+            }
+        });
+    }
+    pool.run();
+    EXPECT_EQ(cnt.load(), 2);
+    EXPECT_EQ(pool.setup_failures(), 0u);
+}
+
+TEST(AsioPool, bad_thread_options) {
+    ccl2::AsioPool::options_t options;
+    options.num  = 2;
+    options.cpus = {-1};
+    EXPECT_THROW(ccl2::AsioPool{options}, std::runtime_error);
+    options.cpus = {CPU_SETSIZE};
+    EXPECT_THROW(ccl2::AsioPool{options}, std::runtime_error);
+}
+#endif
+
+TEST(AsioPool, metrics) {
+    ccl2::AsioPool::options_t options;
+    options.num     = 2;
+    options.metrics = true;
+    ccl2::AsioPool pool(options);
+
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        pool.enqueue([&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            if (++cnt == 100) {
+                pool.shutdown();
+            }
+        });
+    }
+    auto before = pool.metrics();
+    EXPECT_EQ(before.queued, 100u);
+    EXPECT_EQ(before.handlers, 0u);
+
+    pool.run();
+
+    auto m = pool.metrics();
+    EXPECT_EQ(m.handlers, 100u);
+    EXPECT_EQ(m.queued, 0u);
+    EXPECT_EQ(m.run_time.count, 100u);
+    EXPECT_GE(m.run_time.avg_ns, 100000.0);
+    EXPECT_GE(m.run_time.p50_ns, 100000u);
+    EXPECT_LE(m.run_time.p50_ns, m.run_time.p99_ns);
+    EXPECT_LE(m.run_time.p99_ns, m.run_time.max_ns);
+    EXPECT_EQ(m.delay.count, 100u);
+    ASSERT_EQ(m.threads.size(), 2u);
+    EXPECT_EQ(m.threads[0].handlers + m.threads[1].handlers, 100u);
+    EXPECT_GT(m.threads[0].busy_ns + m.threads[1].busy_ns, 100u * 100000u);
+    EXPECT_EQ(m.threads[0].running_ns, 0u);
+}
+
+TEST(AsioPool, drain) {
+    ccl2::AsioPool pool(2);
+
+    std::atomic<int> cnt = 0;
+    for (int i = 0; i < 100; i++) {
+        pool.enqueue([&] {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            cnt++;
+        });
+    }
+    // queued before drain(), all of them are finished
+    pool.enqueue([&] { pool.drain(std::chrono::seconds(10)); });
+
+    ccl2::StopWatch sw;
+    pool.run();
+    EXPECT_LT(sw.elapsed(), 5);
+    EXPECT_EQ(cnt.load(), 100);
+    EXPECT_EQ(pool.dropped(), 0u);
+}
+
+TEST(AsioPool, drain_timeout) {
+    ccl2::AsioPool pool(1);
+    auto& ioc = pool.get_io_context();
+
+    // pending I/O which outlives the deadline
+    boost::asio::steady_timer timer(ioc, std::chrono::seconds(10));
+    timer.async_wait([](boost::system::error_code) {});
+
+    bool ran = false;
+    pool.enqueue([&] {
+        pool.drain(std::chrono::milliseconds(20));
+        // rejected
+        pool.enqueue([&] { ran = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+    // queued, but abandoned at the deadline
+    pool.enqueue([&] { ran = true; });
+
+    ccl2::StopWatch sw;
+    pool.run();
+    EXPECT_LT(sw.elapsed(), 5);
+    EXPECT_FALSE(ran);
+    EXPECT_EQ(pool.dropped(), 2u);
+}
+
+TEST(AsioPool, resize) {
+    ccl2::AsioPool pool(2);
+    EXPECT_EQ(pool.worker_count(), 2u);
+
+    std::mutex mtx;
+    std::set<std::thread::id> threads;
+    std::atomic<int> cnt = 0;
+    pool.enqueue([&] {
+        pool.resize(4);
+        for (int i = 0; i < 200; i++) {
+            // enqueue() would run it inline
+            boost::asio::post(pool.get_executor(), [&] {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                {
+                    std::lock_guard _lck{mtx};
+                    threads.insert(std::this_thread::get_id());
+                }
+                if (++cnt == 200) {
+                    pool.resize(1);
+                    pool.enqueue([&] { pool.drain(std::chrono::seconds(5)); });
+                }
+            });
+        }
+    });
+    pool.run();
+
+    EXPECT_EQ(pool.worker_count(), 1u);
+    EXPECT_EQ(cnt.load(), 200);
+    EXPECT_GT(threads.size(), 2u);
+    EXPECT_THROW(pool.resize(0), std::runtime_error);
+
+    ccl2::AsioPool sharded(2, ccl2::AsioPool::mode_t::sharded);
+    EXPECT_THROW(sharded.resize(3), std::runtime_error);
+
+    // set up for one thread
+    ccl2::AsioPool single(1);
+    EXPECT_THROW(single.resize(2), std::runtime_error);
+    single.resize(1);
+    EXPECT_EQ(single.worker_count(), 1u);
+}
+
+#ifdef __linux__
+// the threads of this process named `<prefix>-<i>`
+static size_t count_threads(const std::string& prefix) {
+    size_t n = 0;
+    for (const auto& task : std::filesystem::directory_iterator("/proc/self/task")) {
+        std::ifstream comm(task.path() / "comm");
+        std::string name;
+        std::getline(comm, name);
+        n += name.rfind(prefix + "-", 0) == 0;
+    }
+    return n;
+}
+
+TEST(AsioPool, resize_idle) {
+    ccl2::AsioPool::options_t options;
+    options.num  = 4;
+    options.name = "ccl2-idle";
+    ccl2::AsioPool pool(options);
+    std::thread th([&] { pool.run(); });
+
+    auto wait_threads = [](size_t n) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (count_threads("ccl2-idle") != n
+               && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return count_threads("ccl2-idle");
+    };
+    EXPECT_EQ(wait_threads(4), 4u);
+
+    // the idle threads exit, whichever of them takes the exit requests
+    pool.resize(1);
+    EXPECT_EQ(pool.worker_count(), 1u);
+    EXPECT_EQ(wait_threads(1), 1u);
+
+    pool.resize(3);
+    EXPECT_EQ(wait_threads(3), 3u);
+
+    // the pool still runs handlers
+    std::atomic<bool> ran = false;
+    pool.enqueue([&] { ran = true; });
+    while (!ran) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    pool.shutdown();
+    th.join();
+    EXPECT_EQ(count_threads("ccl2-idle"), 0u);
+}
+#endif
+
+TEST(AsioPool, autoscale) {
+    ccl2::AsioPool::options_t options;
+    options.num                  = 2;
+    options.metrics              = true;
+    options.autoscale.max_num    = 3;
+    options.autoscale.min_num    = 1;
+    options.autoscale.interval   = std::chrono::milliseconds(20);
+    options.autoscale.grow_above = 0.5;
+    ccl2::AsioPool pool(options);
+
+    // idle, shrinks to min_num
+    auto& ioc = pool.get_io_context();
+    boost::asio::steady_timer timer(ioc, std::chrono::milliseconds(300));
+    timer.async_wait([&](boost::system::error_code) {
+        EXPECT_EQ(pool.worker_count(), 1u);
+        pool.shutdown();
+    });
+    pool.run();
+
+    options.autoscale.max_num = 0;
+    options.metrics           = false;
+    options.mode              = ccl2::AsioPool::mode_t::sharded;
+    EXPECT_NO_THROW(ccl2::AsioPool{options});
+    options.autoscale.max_num = 3;
+    EXPECT_THROW(ccl2::AsioPool{options}, std::runtime_error);
+}
@@ -0,0 +1,482 @@
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/asio_pool.h>
+#include <ccl2/async_queue.h>
+#include <ccl2/stopwatch.h>
+#include <gtest/gtest.h>
+
+namespace asio = boost::asio;
+
+TEST(AsyncQueue, try_pop) {
+    ccl2::AsioPool pool(1);
+    ccl2::AsyncQueue<int> q(pool.get_io_context(), 4);
+
+    // beyond the ring, spill into the overflow list
+    for (int i = 0; i < 10; i++) {
+        q.push(int(i));
+    }
+    EXPECT_EQ(q.size(), 10);
+
+    auto r = q.try_pop();
+    ASSERT_EQ(r.size(), 10u);
+    int expect = 0;
+    for (auto v : r) {
+        EXPECT_EQ(v, expect++);
+    }
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(AsyncQueue, producers) {
+    constexpr int kProducers = 4;
+    constexpr int kItems     = 20000;
+
+    ccl2::AsioPool pool(1);
+    ccl2::AsyncQueue<int> q(pool.get_io_context(), 64);
+
+    std::vector<int> last(kProducers, -1);
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            int total = 0;
+            while (total < kProducers * kItems) {
+                auto r = co_await q.pop();
+                for (auto v : r) {
+                    // FIFO per producer
+                    int p = v / kItems, i = v % kItems;
+                    EXPECT_EQ(last[p] + 1, i);
+                    last[p] = i;
+                }
+                total += r.size();
+            }
+            pool.shutdown();
+        },
+        asio::detached);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&q, p] {
+            for (int i = 0; i < kItems; i++) {
+                q.push(p * kItems + i);
+            }
+        });
+    }
+
+    pool.run();
+    for (auto& th : producers) {
+        th.join();
+    }
+    for (auto v : last) {
+        EXPECT_EQ(v, kItems - 1);
+    }
+}
+
+TEST(AsyncQueue, pop_batch) {
+    using namespace std::chrono_literals;
+    ccl2::AsioPool pool(1);
+    ccl2::AsyncQueue<int> q(pool.get_io_context(), 4);
+
+    for (int i = 0; i < 6; i++) {
+        q.push(int(i));
+    }
+
+    std::thread producer;
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            // enough items, no wait
+            ccl2::StopWatch sw;
+            auto r = co_await q.pop_batch(4, 10s);
+            EXPECT_EQ(r, (std::vector<int>{0, 1, 2, 3}));
+            EXPECT_LT(sw.elapsed(), 1);
+
+            // linger until the deadline
+            sw.reset();
+            r = co_await q.pop_batch(4, 50ms);
+            EXPECT_EQ(r, (std::vector<int>{4, 5}));
+            EXPECT_GE(sw.elapsed(), 0.045);
+
+            r = co_await q.pop_batch(4, 10ms);
+            EXPECT_TRUE(r.empty());
+
+            // filled up by a producer before the deadline
+            producer = std::thread([&] {
+                for (int i = 0; i < 100; i++) {
+                    q.push(int(i));
+                }
+            });
+            sw.reset();
+            r = co_await q.pop_batch(100, 10s);
+            EXPECT_EQ(r.size(), 100u);
+            EXPECT_LT(sw.elapsed(), 5);
+            pool.shutdown();
+        },
+        asio::detached);
+
+    pool.run();
+    producer.join();
+}
+
+TEST(AsyncQueue, consumers) {
+    constexpr int kConsumers = 8;
+    constexpr int kItems     = 20000;
+
+    ccl2::AsioPool pool(4);
+    ccl2::AsyncQueue<int> q(pool.get_io_context(), 64);
+
+    std::vector<std::atomic<int>> seen(kItems);
+    std::vector<int> taken(kConsumers, 0);
+    std::atomic<int> total = 0;
+    for (int c = 0; c < kConsumers; c++) {
+        asio::co_spawn(
+            pool.get_io_context(),
+            [&, c]() -> asio::awaitable<void> {
+                for (;;) {
+                    int v = *co_await q.pop_one();
+                    seen[v]++;
+                    taken[c]++;
+                    if (++total == kItems) {
+                        pool.shutdown();
+                    }
+                }
+            },
+            asio::detached);
+    }
+
+    // one item resumes one consumer
+    std::thread producer([&] {
+        while (q.waiting() < size_t(kConsumers)) {
+            std::this_thread::yield();
+        }
+        q.push(0);
+        while (total.load() == 0) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_EQ(q.waiting(), size_t(kConsumers));
+
+        for (int i = 1; i < kItems; i++) {
+            q.push(int(i));
+        }
+    });
+
+    pool.run();
+    producer.join();
+    EXPECT_EQ(total.load(), kItems);
+    for (auto& v : seen) {
+        EXPECT_EQ(v.load(), 1);
+    }
+    int busy = 0;
+    for (auto n : taken) {
+        busy += n > 0;
+    }
+    EXPECT_GT(busy, 1);
+}
+
+TEST(AsyncQueue, close) {
+    ccl2::AsioPool pool(2);
+    ccl2::AsyncQueue<int> q(pool.get_io_context());
+    ccl2::BoundedAsyncQueue<int> bq(2);
+
+    std::atomic<int> done = 0;
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            auto r = co_await q.pop();
+            EXPECT_EQ(r, (std::list<int>{1, 2}));
+            // parked until closed, then end-of-stream
+            r = co_await q.pop();
+            EXPECT_TRUE(r.empty());
+            auto v = co_await q.pop_one();
+            EXPECT_FALSE(v);
+            if (++done == 2) {
+                pool.shutdown();
+            }
+        },
+        asio::detached);
+
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            EXPECT_TRUE(co_await bq.push(1));
+            EXPECT_TRUE(co_await bq.push(2));
+            // blocked on the full queue until closed
+            EXPECT_FALSE(co_await bq.push(3));
+            auto r = co_await bq.pop();
+            EXPECT_EQ(r, (std::list<int>{1, 2}));
+            r = co_await bq.pop();
+            EXPECT_TRUE(r.empty());
+            if (++done == 2) {
+                pool.shutdown();
+            }
+        },
+        asio::detached);
+
+    std::thread th([&] {
+        q.push(1);
+        q.push(2);
+        while (q.waiting() == 0 || !bq.full()) {
+            std::this_thread::yield();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        q.close();
+        bq.close();
+        EXPECT_FALSE(q.push(3));
+    });
+
+    pool.run();
+    th.join();
+    EXPECT_EQ(done.load(), 2);
+}
+
+TEST(AsyncQueue, wake) {
+    ccl2::AsioPool pool(2);
+    ccl2::AsyncQueue<int> q(pool.get_io_context());
+
+    std::atomic<bool> done = false;
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            // parked until woken, then returns empty
+            auto r = co_await q.pop();
+            EXPECT_TRUE(r.empty());
+            done = true;
+            pool.shutdown();
+        },
+        asio::detached);
+
+    std::thread th([&] {
+        while (q.waiting() == 0) {
+            std::this_thread::yield();
+        }
+        q.wake();
+    });
+
+    pool.run();
+    th.join();
+    EXPECT_TRUE(done.load());
+}
+
+TEST(AsyncQueue, select) {
+    using namespace std::chrono_literals;
+    ccl2::AsioPool pool(2);
+    ccl2::AsyncQueue<int> q1(pool.get_io_context());
+    ccl2::BoundedAsyncQueue<std::string> q2(4);
+
+    std::thread producer;
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            asio::steady_timer timer(co_await asio::this_coro::executor, 10s);
+
+            // ready already
+            q1.push(1);
+            EXPECT_EQ(co_await ccl2::select(q1, q2, timer), 0u);
+            EXPECT_EQ(q1.try_pop(), (std::list<int>{1}));
+
+            // resumed by a push from another thread
+            producer = std::thread([&] {
+                while (q1.waiting() == 0 || q2.waiters().size() == 0) {
+                    std::this_thread::yield();
+                }
+                q2.try_push(std::string("hello"));
+            });
+            EXPECT_EQ(co_await ccl2::select(q1, q2, timer), 1u);
+            EXPECT_EQ(q2.try_pop(), (std::list<std::string>{"hello"}));
+            // the losers are not left in the queues
+            EXPECT_EQ(q1.waiting(), 0u);
+
+            timer.expires_after(20ms);
+            EXPECT_EQ(co_await ccl2::select(q1, q2, timer), 2u);
+            EXPECT_EQ(q1.waiting(), 0u);
+            EXPECT_EQ(q2.waiters().size(), 0u);
+
+            q2.close();
+            timer.expires_after(10s);
+            EXPECT_EQ(co_await ccl2::select(q1, q2, timer), 1u);
+
+            // another wait on the timer is not cancelled when a queue wins
+            boost::system::error_code timer_ec = asio::error::would_block;
+            timer.expires_after(20ms);
+            timer.async_wait([&](boost::system::error_code ec) { timer_ec = ec; });
+            q1.push(2);
+            EXPECT_EQ(co_await ccl2::select(q1, timer), 0u);
+            asio::steady_timer later(co_await asio::this_coro::executor, 50ms);
+            co_await later.async_wait(asio::use_awaitable);
+            EXPECT_EQ(timer_ec, boost::system::error_code{});
+            pool.shutdown();
+        },
+        asio::detached);
+
+    pool.run();
+    producer.join();
+}
+
+TEST(AsyncQueue, cancel) {
+    asio::io_context ioc;
+    ccl2::AsyncQueue<int> q(ioc);
+    asio::steady_timer timer(ioc, std::chrono::seconds(10));
+
+    // a parked pop() and select() complete with operation_aborted once cancelled
+    asio::cancellation_signal pop_sig, select_sig;
+    boost::system::error_code pop_ec, select_ec;
+    auto on_done = [](boost::system::error_code& ec) {
+        return [&ec](std::exception_ptr e) {
+            if (!e) {
+                return;
+            }
+            try {
+                std::rethrow_exception(e);
+            } catch (const boost::system::system_error& se) {
+                ec = se.code();
+            }
+        };
+    };
+    asio::co_spawn(
+        ioc, [&]() -> asio::awaitable<void> { co_await q.pop(); },
+        asio::bind_cancellation_slot(pop_sig.slot(), on_done(pop_ec)));
+    asio::co_spawn(
+        ioc, [&]() -> asio::awaitable<void> { co_await ccl2::select(q, timer); },
+        asio::bind_cancellation_slot(select_sig.slot(), on_done(select_ec)));
+
+    ioc.poll();
+    EXPECT_EQ(q.waiting(), 2u);
+    pop_sig.emit(asio::cancellation_type::terminal);
+    select_sig.emit(asio::cancellation_type::terminal);
+    ioc.run_for(std::chrono::seconds(1));
+
+    EXPECT_EQ(pop_ec, asio::error::operation_aborted);
+    EXPECT_EQ(select_ec, asio::error::operation_aborted);
+    // the cancelled waiters are not left in the queue
+    EXPECT_EQ(q.waiting(), 0u);
+}
+
+TEST(BoundedAsyncQueue, policy) {
+    using queue_t = ccl2::BoundedAsyncQueue<int>;
+
+    queue_t block(4);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(block.try_push(int(i)));
+    }
+    int v = 4;
+    EXPECT_FALSE(block.try_push(std::move(v)));
+    EXPECT_TRUE(block.full());
+    EXPECT_EQ(block.dropped(), 0u);
+
+    queue_t newest(4, queue_t::policy_t::drop_newest);
+    queue_t oldest(4, queue_t::policy_t::drop_oldest);
+    for (int i = 0; i < 6; i++) {
+        newest.try_push(int(i));
+        oldest.try_push(int(i));
+    }
+    EXPECT_EQ(newest.dropped(), 2u);
+    EXPECT_EQ(oldest.dropped(), 2u);
+    EXPECT_EQ(newest.try_pop(), (std::list<int>{0, 1, 2, 3}));
+    EXPECT_EQ(oldest.try_pop(), (std::list<int>{2, 3, 4, 5}));
+}
+
+TEST(BoundedAsyncQueue, backpressure) {
+    constexpr int kProducers = 4;
+    constexpr int kItems     = 5000;
+
+    ccl2::AsioPool pool(2);
+    ccl2::BoundedAsyncQueue<int> q(8);
+
+    std::atomic<int> done = 0;
+    for (int p = 0; p < kProducers; p++) {
+        asio::co_spawn(
+            pool.get_io_context(),
+            [&q, &done, p]() -> asio::awaitable<void> {
+                for (int i = 0; i < kItems; i++) {
+                    EXPECT_TRUE(co_await q.push(p * kItems + i));
+                    EXPECT_LE(q.size(), q.capacity());
+                }
+                done++;
+            },
+            asio::detached);
+    }
+
+    std::vector<int> last(kProducers, -1);
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            int total = 0;
+            while (total < kProducers * kItems) {
+                auto r = co_await q.pop();
+                for (auto v : r) {
+                    int p = v / kItems, i = v % kItems;
+                    EXPECT_EQ(last[p] + 1, i);
+                    last[p] = i;
+                }
+                total += r.size();
+            }
+            pool.shutdown();
+        },
+        asio::detached);
+
+    pool.run();
+    EXPECT_EQ(done.load(), kProducers);
+    EXPECT_EQ(q.dropped(), 0u);
+    for (auto v : last) {
+        EXPECT_EQ(v, kItems - 1);
+    }
+}
+
+TEST(PriorityAsyncQueue, lanes) {
+    // strict priority
+    ccl2::PriorityAsyncQueue<int, 3> strict(0);
+    for (int i = 0; i < 3; i++) {
+        strict.push(100 + i, 2);
+    }
+    strict.push(1, 1);
+    strict.push(0, 0);
+    EXPECT_EQ(strict.size(), 5u);
+    EXPECT_EQ(strict.size(2), 3u);
+    EXPECT_EQ(strict.try_pop(), (std::list<int>{0, 1, 100, 101, 102}));
+    EXPECT_THROW(strict.push(0, 3), std::runtime_error);
+
+    // the low lane is served after being passed over twice
+    ccl2::PriorityAsyncQueue<int, 3> fair(2);
+    for (int i = 0; i < 6; i++) {
+        fair.push(int(i), 0);
+    }
+    for (int i = 0; i < 2; i++) {
+        fair.push(100 + i, 2);
+    }
+    std::vector<int> order;
+    while (auto v = fair.try_pop_one()) {
+        order.push_back(*v);
+    }
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 100, 2, 3, 101, 4, 5}));
+}
+
+TEST(PriorityAsyncQueue, pop) {
+    ccl2::AsioPool pool(1);
+    ccl2::PriorityAsyncQueue<std::string, 2> q;
+
+    asio::co_spawn(
+        pool.get_io_context(),
+        [&]() -> asio::awaitable<void> {
+            auto v = co_await q.pop_one();
+            EXPECT_EQ(*v, "health");
+            auto r = co_await q.pop_batch(3, std::chrono::seconds(1));
+            EXPECT_EQ(r.size(), 3u);
+            q.close();
+            r = co_await q.pop_batch(100, std::chrono::seconds(10));
+            EXPECT_EQ(r.size(), 7u);
+            v = co_await q.pop_one();
+            EXPECT_FALSE(v);
+            pool.shutdown();
+        },
+        asio::detached);
+
+    for (int i = 0; i < 10; i++) {
+        q.push("bulk", 1);
+    }
+    q.push("health", 0);
+    pool.run();
+}
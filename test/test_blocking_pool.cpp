@@ -0,0 +1,135 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <ccl2/asio_pool.h>
+#include <ccl2/blocking_pool.h>
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+TEST(BlockingPool, bounded) {
+    ccl2::BlockingPool pool(1, 1);
+    std::atomic<bool> release = false;
+
+    EXPECT_TRUE(pool.try_enqueue([&] {
+        while (!release) {
+            std::this_thread::sleep_for(1ms);
+        }
+    }));
+    while (pool.active() != 1) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    EXPECT_TRUE(pool.try_enqueue([] {}));
+    EXPECT_EQ(pool.queue_depth(), 1u);
+    EXPECT_FALSE(pool.try_enqueue([] {}));
+    EXPECT_THROW(pool.enqueue([] {}), ccl2::pool_full_error);
+
+    release = true;
+}
+
+TEST(BlockingPool, burst) {
+    ccl2::BlockingPool pool(4);
+
+    // one idle thread
+    std::atomic<bool> done = false;
+    pool.enqueue([&] { done = true; });
+    while (!done || pool.active() != 0) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // a burst runs on as many threads as allowed, not one after another
+    constexpr int kJobs = 4;
+    std::atomic<int> arrived{0};
+    std::atomic<int> together{0};
+    std::atomic<int> finished{0};
+    for (int i = 0; i < kJobs; i++) {
+        pool.enqueue([&] {
+            arrived++;
+            auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (arrived < kJobs && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(1ms);
+            }
+            if (arrived == kJobs) {
+                together++;
+            }
+            finished++;
+        });
+    }
+    while (finished < kJobs) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_EQ(together.load(), kJobs);
+}
+
+#ifdef CCL2_USE_COROUTINES
+TEST(BlockingPool, offload) {
+    ccl2::AsioPool ioc_pool(1);
+    ccl2::BlockingPool pool(2);
+    auto& ioc = ioc_pool.get_io_context();
+
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<std::string> {
+            auto io_thread = std::this_thread::get_id();
+
+            std::string s = co_await ccl2::offload(pool, [&] {
+                EXPECT_NE(std::this_thread::get_id(), io_thread);
+                return std::string("hello");
+            });
+            // resume on the io thread
+            EXPECT_EQ(std::this_thread::get_id(), io_thread);
+
+            co_await ccl2::offload(pool, [] {});
+            EXPECT_EQ(std::this_thread::get_id(), io_thread);
+
+            EXPECT_THROW(co_await ccl2::offload(pool,
+                                                []() -> int {
+                                                    throw std::runtime_error("oops");
+                                                }),
+                         std::runtime_error);
+            co_return s;
+        },
+        [&](std::exception_ptr e, std::string s) {
+            EXPECT_TRUE(!e);
+            EXPECT_EQ(s, "hello");
+            ioc_pool.shutdown();
+        });
+    ioc_pool.run();
+}
+
+TEST(BlockingPool, offload_full) {
+    ccl2::AsioPool ioc_pool(1);
+    ccl2::BlockingPool pool(1, 1);
+    auto& ioc = ioc_pool.get_io_context();
+
+    std::atomic<bool> release = false;
+    EXPECT_TRUE(pool.try_enqueue([&] {
+        while (!release) {
+            std::this_thread::sleep_for(1ms);
+        }
+    }));
+    while (pool.active() != 1) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_TRUE(pool.try_enqueue([] {}));
+
+    bool ran = false;
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            // thrown before the job runs, the caller still owns what it captured
+            EXPECT_THROW(co_await ccl2::offload(pool, [&] { ran = true; }),
+                         ccl2::pool_full_error);
+        },
+        [&](std::exception_ptr e) {
+            EXPECT_TRUE(!e);
+            release = true;
+            ioc_pool.shutdown();
+        });
+    ioc_pool.run();
+    EXPECT_FALSE(ran);
+}
+#endif
@@ -1,3 +1,9 @@
+#include <array>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
 #include <ccl2/function.h>
 #include <gtest/gtest.h>
 
@@ -21,6 +27,14 @@ public:
     int add(int a, int b) { return a + b; }
 };
 
+struct Tracker {
+    static inline int alive = 0;
+    Tracker() { alive++; }
+    Tracker(const Tracker&) { alive++; }
+    Tracker(Tracker&&) noexcept { alive++; }
+    ~Tracker() { alive--; }
+};
+
 }  // namespace
 
 TEST(Function, function_ptr) {
@@ -51,3 +65,140 @@ TEST(Function, lambda) {
     EXPECT_TRUE(b);
     EXPECT_TRUE(ccl2::invoke(f, 4, 3) == 7);
 }
+
+TEST(Function, move_only) {
+    auto p = std::make_unique<int>(3);
+    auto f = ccl2::bind([p = std::move(p)](int a, int b) { return a + b + *p; });
+    EXPECT_EQ(ccl2::invoke(f, 4, 3), 10);
+
+    auto f2 = std::move(f);
+    EXPECT_FALSE(f);
+    EXPECT_EQ(ccl2::invoke(f2, 4, 3), 10);
+}
+
+TEST(Function, storage) {
+    // inline and allocated, both destroyed exactly once
+    {
+        Tracker t;
+        std::array<char, 128> big{};
+        auto small = ccl2::bind([t](int a) { return a; });
+        auto large = ccl2::bind([t, big](int a) { return a + big[0]; });
+        EXPECT_EQ(Tracker::alive, 3);
+
+        ccl2::function<int> moved;
+        moved = std::move(large);
+        moved = std::move(small);
+        EXPECT_EQ(Tracker::alive, 2);
+        EXPECT_EQ(ccl2::invoke(moved, 7), 7);
+    }
+    EXPECT_EQ(Tracker::alive, 0);
+
+    // a larger inline buffer
+    std::array<char, 96> big{};
+    ccl2::function<void, 128> f([big](void*, void* r) { *(size_t*)r = big.size(); });
+    size_t r = 0;
+    f(nullptr, &r);
+    EXPECT_EQ(r, 96u);
+}
+
+TEST(Function, signature) {
+    auto f = ccl2::bind([](const std::string& s, int n) { return s.size() + n; });
+    EXPECT_TRUE((f.accepts<void(std::string, int)>()));
+    EXPECT_FALSE((f.accepts<void(std::string, double)>()));
+
+    std::string s = "hello";
+    EXPECT_EQ(ccl2::invoke(f, s, 1), 6u);
+    EXPECT_EQ(ccl2::invoke(f, std::cref(s), 1), 6u);
+    EXPECT_THROW(ccl2::invoke(f, s, 1.0), std::runtime_error);
+    EXPECT_THROW(ccl2::invoke(f, "hello", 1), std::runtime_error);
+    EXPECT_THROW(ccl2::invoke(f, s), std::runtime_error);
+
+    // arrays decay to pointers, the pointee type must match exactly
+    int buf[4] = {1, 2, 3, 4};
+    auto sum   = ccl2::bind([](int* p, int n) { return p[0] + p[n - 1]; });
+    EXPECT_EQ(ccl2::invoke(sum, buf, 4), 5);
+    EXPECT_THROW(ccl2::invoke(sum, (const int*)buf, 4), std::runtime_error);
+}
+
+TEST(Function, result_in_place) {
+    struct Result {
+        explicit Result(int v) : v(v) {}
+        int v;
+    };
+    auto f = ccl2::bind([](int a) { return Result(a); });
+    EXPECT_EQ(ccl2::invoke(f, 42).v, 42);
+
+    // by reference, not copied
+    int n  = 0;
+    auto g = ccl2::bind([](int& x) { x++; });
+    ccl2::invoke(g, n);
+    ccl2::invoke(g, std::ref(n));
+    EXPECT_EQ(n, 2);
+
+    // rvalue reference parameters move from the argument
+    auto h = ccl2::bind([](std::unique_ptr<int>&& p) { return std::move(p); });
+    auto p = ccl2::invoke(h, std::make_unique<int>(7));
+    EXPECT_EQ(*p, 7);
+}
+
+TEST(Function, raw_result) {
+    // a default constructible R is constructed before the call, assigned by the callee
+    ccl2::function<std::string> f([](void* args, void* result) {
+        auto argv = static_cast<void**>(args);
+        auto& r   = *static_cast<std::string*>(result);
+        r         = *static_cast<std::string*>(argv[0]) + "!";
+    });
+    EXPECT_EQ(ccl2::invoke(f, std::string("hi")), "hi!");
+
+    // otherwise the callee constructs it through the slot
+    struct Result {
+        explicit Result(int v) : v(v) {}
+        int v;
+    };
+    ccl2::function<Result> g([](void*, void* result) {
+        static_cast<ccl2::result_slot<Result>*>(result)->emplace(7);
+    });
+    EXPECT_EQ(ccl2::invoke(g).v, 7);
+
+    // an early return constructs nothing, and nothing is destroyed
+    ccl2::function<Result> h([](void*, void*) {});
+    EXPECT_THROW(ccl2::invoke(h), std::runtime_error);
+}
+
+TEST(Function, empty) {
+    ccl2::function<int> f;
+    EXPECT_THROW(ccl2::invoke(f), std::bad_function_call);
+    EXPECT_THROW(ccl2::invoke(ccl2::with_signature<int(int)>, f, 1),
+                 std::bad_function_call);
+
+    // nothing to return
+    ccl2::function<void> g;
+    ccl2::invoke(g);
+}
+
+TEST(Function, reference_binding) {
+    // a const argument never binds to a non-const reference
+    auto inc    = ccl2::bind([](int& x) { x++; });
+    const int c = 1;
+    EXPECT_THROW(ccl2::invoke(inc, c), std::runtime_error);
+    EXPECT_THROW(ccl2::invoke(inc, std::cref(c)), std::runtime_error);
+    EXPECT_THROW(ccl2::invoke(ccl2::with_signature<void(int&)>, inc, c),
+                 std::runtime_error);
+    EXPECT_EQ(c, 1);
+
+    // an lvalue to an rvalue reference is copied, every handler sees the value
+    std::vector<std::string> seen;
+    auto take = ccl2::bind([&](std::string&& s) { seen.push_back(std::move(s)); });
+    std::string s = "hello";
+    ccl2::invoke(take, s);
+    ccl2::invoke(take, std::ref(s));
+    ccl2::invoke(ccl2::with_signature<void(std::string&&)>, take, s);
+    EXPECT_EQ(s, "hello");
+    ccl2::invoke(take, std::move(s));
+    EXPECT_EQ(seen, (std::vector<std::string>(4, "hello")));
+
+    auto h = ccl2::bind([](std::unique_ptr<int>&& p) { return std::move(p); });
+    auto p = std::make_unique<int>(7);
+    EXPECT_THROW(ccl2::invoke(h, p), std::runtime_error);
+    EXPECT_EQ(*p, 7);
+}
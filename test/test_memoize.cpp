@@ -0,0 +1,156 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/memoize.h>
+#include <ccl2/service.h>
+#include <gtest/gtest.h>
+
+TEST(Memoize, cache) {
+    int n = 0;
+    auto repeat = ccl2::memoize([&](const std::string& s, int times) {
+        n++;
+        std::string r;
+        for (int i = 0; i < times; i++) {
+            r += s;
+        }
+        return r;
+    });
+
+    EXPECT_EQ(repeat("ab", 2), "abab");
+    EXPECT_EQ(repeat("ab", 2), "abab");
+    EXPECT_EQ(repeat("ab", 3), "ababab");
+    EXPECT_EQ(n, 2);
+
+    // the copies share the cache
+    auto copy = repeat;
+    EXPECT_EQ(copy("ab", 3), "ababab");
+    EXPECT_EQ(n, 2);
+    auto m = repeat.metrics();
+    EXPECT_EQ(m.hits, 2u);
+    EXPECT_EQ(m.misses, 2u);
+    EXPECT_EQ(m.size, 2u);
+
+    copy.clear();
+    EXPECT_EQ(repeat("ab", 2), "abab");
+    EXPECT_EQ(n, 3);
+}
+
+TEST(Memoize, ttl) {
+    int n = 0;
+    ccl2::MemoizeOptions options;
+    options.ttl = std::chrono::milliseconds(20);
+    auto square = ccl2::memoize<int(int)>(
+        [&](int v) {
+            n++;
+            return v * v;
+        },
+        options);
+
+    EXPECT_EQ(square(3), 9);
+    EXPECT_EQ(square(3), 9);
+    EXPECT_EQ(n, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(square(3), 9);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(square.metrics().size, 1u);
+}
+
+TEST(Memoize, lru) {
+    int n = 0;
+    ccl2::MemoizeOptions options;
+    options.capacity = 2;
+    auto square      = ccl2::memoize<int(int)>(
+        [&](int v) {
+            n++;
+            return v * v;
+        },
+        options);
+
+    square(1);
+    square(2);
+    square(1);  // 2 is the least recently used
+    square(3);
+    EXPECT_EQ(n, 3);
+    square(1);
+    EXPECT_EQ(n, 3);
+    square(2);
+    EXPECT_EQ(n, 4);
+
+    auto m = square.metrics();
+    EXPECT_EQ(m.size, 2u);
+    EXPECT_EQ(m.evictions, 2u);
+}
+
+TEST(Memoize, single_flight) {
+    std::atomic<int> n{0};
+    auto slow = ccl2::memoize<int(int)>([&](int v) {
+        n++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return v + 1;
+    });
+
+    constexpr int kThreads = 8;
+    std::atomic<int> ok{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; i++) {
+        threads.emplace_back([&] {
+            if (slow(41) == 42) {
+                ok++;
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    EXPECT_EQ(n.load(), 1);
+    EXPECT_EQ(ok.load(), kThreads);
+    EXPECT_EQ(slow.metrics().hits, uint64_t(kThreads - 1));
+}
+
+TEST(Memoize, exception) {
+    int n    = 0;
+    auto div = ccl2::memoize<int(int)>([&](int v) {
+        n++;
+        if (v == 0) {
+            throw std::runtime_error("divide by zero");
+        }
+        return 100 / v;
+    });
+
+    // not cached
+    EXPECT_THROW(div(0), std::runtime_error);
+    EXPECT_THROW(div(0), std::runtime_error);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(div(5), 20);
+    EXPECT_EQ(div.metrics().size, 1u);
+}
+
+TEST(Memoize, service) {
+    static const ccl2::Topic<int(int, int)> kAdd{"/add"};
+
+    int n = 0;
+    ccl2::Service<> svc;
+    svc.register_handler(
+        kAdd,
+        [&](int a, int b) {
+            n++;
+            return a + b;
+        },
+        ccl2::MemoizeOptions{});
+    auto mul = ccl2::memoize([&](int a, int b) {
+        n++;
+        return a * b;
+    });
+    svc.register_handler("/mul", mul);
+
+    EXPECT_EQ(svc.call(kAdd, 3, 4), 7);
+    EXPECT_EQ(svc.call<int>("/add", 3, 4), 7);
+    EXPECT_EQ(svc.resolve(kAdd)(3, 4), 7);
+    EXPECT_EQ(svc.call<int>("/mul", 3, 4), 12);
+    EXPECT_EQ(svc.call<int>("/mul", 3, 4), 12);
+    EXPECT_EQ(n, 2);
+    EXPECT_EQ(mul.metrics().hits, 1u);
+}
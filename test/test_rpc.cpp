@@ -0,0 +1,323 @@
+#ifdef CCL2_USE_COROUTINES
+
+#    include <algorithm>
+#    include <atomic>
+#    include <chrono>
+#    include <map>
+#    include <memory>
+#    include <optional>
+#    include <stdexcept>
+#    include <string>
+#    include <thread>
+#    include <tuple>
+#    include <unistd.h>
+#    include <vector>
+#    include <ccl2/rpc.h>
+#    include <gtest/gtest.h>
+
+namespace {
+
+struct Point {
+    BOOST_HANA_DEFINE_STRUCT(Point, (int, x), (double, y), (std::string, tag));
+};
+
+enum class Color : uint8_t { red, green };
+
+const ccl2::Topic<int(int, int)> kAdd{"/add"};
+const ccl2::Topic<std::string(const std::string&, int)> kRepeat{"/repeat"};
+const ccl2::Topic<Point(Point)> kFlip{"/flip"};
+const ccl2::Topic<void(int)> kStore{"/store"};
+const ccl2::Topic<int()> kFail{"/fail"};
+const ccl2::Topic<int()> kFailEmpty{"/fail_empty"};
+const ccl2::Topic<boost::asio::awaitable<int>(int)> kSleep{"/sleep"};
+
+template <class T>
+T round_trip(const T& v) {
+    std::string out;
+    ccl2::rpc::encode(out, v);
+    return ccl2::rpc::decode<T>(out);
+}
+
+// every kind of call, against a server on `acceptor`
+template <class Protocol>
+void run_calls(boost::asio::io_context& ioc,
+               typename Protocol::acceptor& acceptor) {
+    ccl2::Service<> svc;
+    int stored = 0;
+    svc.register_handler(kAdd, [](int a, int b) { return a + b; });
+    svc.register_handler(kRepeat, [](const std::string& s, int n) {
+        std::string r;
+        for (int i = 0; i < n; i++) {
+            r += s;
+        }
+        return r;
+    });
+    svc.register_handler(kFlip, [](Point p) { return Point{-p.x, -p.y, p.tag}; });
+    svc.register_handler(kStore, [&](int v) { stored = v; });
+    svc.register_handler(kFail, []() -> int { throw std::runtime_error("oops"); });
+    svc.register_handler(kFailEmpty, []() -> int { throw std::runtime_error(""); });
+    svc.register_handler(kSleep, [](int ms) -> boost::asio::awaitable<int> {
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor,
+                                        std::chrono::milliseconds(ms));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_return ms;
+    });
+
+    ccl2::rpc::Server server(svc);
+    server.expose(kAdd);
+    server.expose(kRepeat);
+    server.expose(kFlip);
+    server.expose(kStore);
+    server.expose(kFail);
+    server.expose(kFailEmpty);
+    server.expose(kSleep);
+    EXPECT_THROW(server.expose(kAdd), std::runtime_error);
+    boost::asio::co_spawn(ioc, server.serve(acceptor), boost::asio::detached);
+
+    ccl2::rpc::Client<Protocol> client(ioc.get_executor());
+    bool done = false;
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await client.connect(acceptor.local_endpoint());
+
+            EXPECT_EQ(co_await client.call(kAdd, 3, 4), 7);
+            EXPECT_EQ(co_await client.template call<int>("/add", 5, 6), 11);
+            EXPECT_EQ(co_await client.call(kRepeat, "ab", short(3)), "ababab");
+            Point in{1, 2.5, "p"};
+            auto p = co_await client.call(kFlip, in);
+            EXPECT_EQ(p.x, -1);
+            EXPECT_EQ(p.y, -2.5);
+            EXPECT_EQ(p.tag, "p");
+            co_await client.call(kStore, 42);
+            EXPECT_EQ(stored, 42);
+
+            try {
+                co_await client.call(kFail);
+                ADD_FAILURE();
+            } catch (const std::runtime_error& e) {
+                EXPECT_STREQ(e.what(), "oops");
+            }
+            // an error still, with no message
+            try {
+                co_await client.call(kFailEmpty);
+                ADD_FAILURE();
+            } catch (const std::runtime_error& e) {
+                EXPECT_STREQ(e.what(), "");
+            }
+            try {
+                co_await client.template call<int>("/sub", 1, 2);
+                ADD_FAILURE();
+            } catch (const std::runtime_error& e) {
+                EXPECT_STREQ(e.what(), "expect svc: /sub");
+            }
+            // the arguments do not match the signature
+            EXPECT_THROW(co_await client.template call<int>("/add", 1),
+                         std::runtime_error);
+
+            // pipelined on one connection, the fast calls overtake the slow one
+            std::vector<int> order;
+            auto sleep = [&](int ms) -> boost::asio::awaitable<void> {
+                order.push_back(co_await client.call(kSleep, ms));
+            };
+            int n = 0;
+            for (int ms : {60, 1, 20}) {
+                boost::asio::co_spawn(ioc, sleep(ms), [&](std::exception_ptr e) {
+                    EXPECT_FALSE(e);
+                    n++;
+                });
+            }
+            boost::asio::steady_timer timer(ioc);
+            while (n < 3) {
+                timer.expires_after(std::chrono::milliseconds(5));
+                co_await timer.async_wait(boost::asio::use_awaitable);
+            }
+            EXPECT_EQ(order, (std::vector<int>{1, 20, 60}));
+
+            acceptor.close();
+            client.close();
+            EXPECT_THROW(co_await client.call(kAdd, 1, 2), std::runtime_error);
+            done = true;
+        },
+        boost::asio::detached);
+    ioc.run();
+    EXPECT_TRUE(done);
+}
+
+}  // namespace
+
+TEST(rpc, codec) {
+    EXPECT_EQ(round_trip(-17), -17);
+    EXPECT_EQ(round_trip(uint64_t(1) << 63), uint64_t(1) << 63);
+    EXPECT_EQ(round_trip(3.25), 3.25);
+    EXPECT_EQ(round_trip(true), true);
+    EXPECT_EQ(round_trip(Color::green), Color::green);
+    EXPECT_EQ(round_trip(std::string(300, 'x')), std::string(300, 'x'));
+    EXPECT_EQ(round_trip(std::vector<int>{1, 2, 3}), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(round_trip(std::map<std::string, int>{{"a", 1}, {"b", 2}}),
+              (std::map<std::string, int>{{"a", 1}, {"b", 2}}));
+    EXPECT_EQ(round_trip(std::optional<int>()), std::nullopt);
+    EXPECT_EQ(round_trip(std::optional<int>(5)), 5);
+    EXPECT_EQ(round_trip(std::make_tuple(1, std::string("a"), 2.0)),
+              std::make_tuple(1, std::string("a"), 2.0));
+
+    auto p = round_trip(Point{1, 2.5, "p"});
+    EXPECT_EQ(p.x, 1);
+    EXPECT_EQ(p.y, 2.5);
+    EXPECT_EQ(p.tag, "p");
+
+    // encoded as a std::string
+    std::string out;
+    ccl2::rpc::encode(out, "abc");
+    EXPECT_EQ(ccl2::rpc::decode<std::string>(out), "abc");
+
+    EXPECT_THROW(ccl2::rpc::decode<int>(out.substr(0, 2)), std::runtime_error);
+    EXPECT_THROW(ccl2::rpc::decode<std::string>(out.substr(0, 3)), std::runtime_error);
+    EXPECT_THROW(ccl2::rpc::decode<std::string>(out + "x"), std::runtime_error);
+    EXPECT_THROW(ccl2::rpc::decode<std::vector<int>>("\xff\xff\xff\x7f"),
+                 std::runtime_error);
+}
+
+TEST(rpc, tcp) {
+    using boost::asio::ip::tcp;
+    boost::asio::io_context ioc;
+    tcp::acceptor acceptor(ioc, {boost::asio::ip::address_v4::loopback(), 0});
+    run_calls<tcp>(ioc, acceptor);
+}
+
+TEST(rpc, unix_socket) {
+    using boost::asio::local::stream_protocol;
+    auto path = "/tmp/ccl2_test_rpc_" + std::to_string(::getpid()) + ".sock";
+    ::unlink(path.c_str());
+    boost::asio::io_context ioc;
+    stream_protocol::acceptor acceptor(ioc, stream_protocol::endpoint(path));
+    run_calls<stream_protocol>(ioc, acceptor);
+    ::unlink(path.c_str());
+}
+
+TEST(rpc, max_inflight) {
+    using boost::asio::ip::tcp;
+    boost::asio::io_context ioc;
+    tcp::acceptor acceptor(ioc, {boost::asio::ip::address_v4::loopback(), 0});
+
+    ccl2::Service<> svc;
+    int running     = 0;
+    int max_running = 0;
+    svc.register_handler(kSleep, [&](int ms) -> boost::asio::awaitable<int> {
+        max_running = std::max(max_running, ++running);
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor,
+                                        std::chrono::milliseconds(ms));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        running--;
+        co_return ms;
+    });
+    ccl2::rpc::Server<ccl2::Service<>>::options_t options;
+    options.max_inflight = 2;
+    ccl2::rpc::Server server(svc, options);
+    server.expose(kSleep);
+    boost::asio::co_spawn(ioc, server.serve(acceptor), boost::asio::detached);
+
+    // the requests beyond the limit wait in the socket
+    ccl2::rpc::Client<tcp> client(ioc.get_executor());
+    int done = 0;
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await client.connect(acceptor.local_endpoint());
+            for (int i = 0; i < 8; i++) {
+                boost::asio::co_spawn(
+                    ioc,
+                    [&]() -> boost::asio::awaitable<void> {
+                        co_await client.call(kSleep, 5);
+                    },
+                    [&](std::exception_ptr e) {
+                        EXPECT_FALSE(e);
+                        if (++done == 8) {
+                            acceptor.close();
+                            client.close();
+                        }
+                    });
+            }
+        },
+        boost::asio::detached);
+    ioc.run();
+    EXPECT_EQ(done, 8);
+    EXPECT_EQ(max_running, 2);
+}
+
+TEST(rpc, stop) {
+    using boost::asio::ip::tcp;
+    boost::asio::io_context ioc;
+    tcp::acceptor acceptor(ioc, {boost::asio::ip::address_v4::loopback(), 0});
+
+    ccl2::Service<> svc;
+    svc.register_handler(kAdd, [](int a, int b) { return a + b; });
+    auto server = std::make_unique<ccl2::rpc::Server<ccl2::Service<>>>(svc);
+    server->expose(kAdd);
+    boost::asio::co_spawn(ioc, server->serve(acceptor), boost::asio::detached);
+
+    // destroyed with a client connected, which sees the connection closed
+    ccl2::rpc::Client<tcp> client(ioc.get_executor());
+    bool done = false;
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await client.connect(acceptor.local_endpoint());
+            EXPECT_EQ(co_await client.call(kAdd, 1, 2), 3);
+            server.reset();
+            EXPECT_FALSE(acceptor.is_open());
+            EXPECT_THROW(co_await client.call(kAdd, 1, 2), std::runtime_error);
+            client.close();
+            done = true;
+        },
+        boost::asio::detached);
+    ioc.run();
+    EXPECT_TRUE(done);
+}
+
+TEST(rpc, pipelining) {
+    using boost::asio::ip::tcp;
+    boost::asio::thread_pool pool(2);
+    auto strand = boost::asio::make_strand(pool);
+    tcp::acceptor acceptor(pool, {boost::asio::ip::address_v4::loopback(), 0});
+
+    ccl2::Service<> svc;
+    svc.register_handler(kAdd, [](int a, int b) { return a + b; });
+    ccl2::rpc::Server server(svc);
+    server.expose(kAdd);
+    boost::asio::co_spawn(strand, server.serve(acceptor), boost::asio::detached);
+
+    // many callers on one connection, from the threads of the pool
+    constexpr int kCalls = 2000;
+    std::atomic<int> ok{0};
+    std::atomic<int> done{0};
+    ccl2::rpc::Client<tcp> client(pool.get_executor());
+    boost::asio::co_spawn(
+        pool,
+        [&]() -> boost::asio::awaitable<void> {
+            co_await client.connect(acceptor.local_endpoint());
+        },
+        boost::asio::use_future)
+        .get();
+    for (int i = 0; i < kCalls; i++) {
+        boost::asio::co_spawn(
+            pool,
+            [&, i]() -> boost::asio::awaitable<void> {
+                if (co_await client.call(kAdd, i, 1) == i + 1) {
+                    ok++;
+                }
+            },
+            [&](std::exception_ptr) { done++; });
+    }
+    // a failed call completes too
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (done < kCalls && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    boost::asio::post(strand, [&] { acceptor.close(); });
+    client.close();
+    pool.join();
+    EXPECT_EQ(ok.load(), kCalls);
+}
+
+#endif
@@ -0,0 +1,237 @@
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/service.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Algorithm {
+    int mul(int a, int b) { return a * b; }
+};
+
+}  // namespace
+
+TEST(Service, call) {
+    ccl2::Service<> svc;
+    auto algo = std::make_shared<Algorithm>();
+    svc.register_handler("/add", [](int a, int b) { return a + b; });
+    svc.register_handler("/mul", &Algorithm::mul, algo);
+    svc.register_handler("/name", [] { return std::string("ccl2"); });
+
+    EXPECT_EQ(svc.call<int>("/add", 3, 4), 7);
+    EXPECT_EQ(svc.call<int>("/mul", 3, 4), 12);
+    EXPECT_EQ(svc.call<std::string>("/name"), "ccl2");
+    EXPECT_THROW(svc.register_handler("/add", [](int a) { return a; }),
+                 std::runtime_error);
+    EXPECT_THROW(svc.call<int>("/sub", 3, 4), std::runtime_error);
+}
+
+TEST(Service, checked) {
+    ccl2::Service<> svc;
+    svc.register_handler("/add", [](int a, int b) { return a + b; });
+    EXPECT_THROW(svc.call<int>("/add", 3, 4.0), std::runtime_error);
+    EXPECT_THROW(svc.call<long>("/add", 3, 4), std::runtime_error);
+    EXPECT_THROW(svc.call<int>("/add", 3), std::runtime_error);
+}
+
+TEST(Service, topic) {
+    static const ccl2::Topic<std::string(const std::string&, int)> kRepeat{"/repeat"};
+
+    ccl2::Service<> svc;
+    svc.register_handler(kRepeat, [](const std::string& s, int n) {
+        std::string r;
+        for (int i = 0; i < n; i++) {
+            r += s;
+        }
+        return r;
+    });
+
+    // converted at compile time, the result type comes from the topic
+    auto r = svc.call(kRepeat, "ab", short(3));
+    EXPECT_EQ(r, "ababab");
+    EXPECT_EQ(svc.call<std::string>("/repeat", std::string("a"), 2), "aa");
+}
+
+TEST(Service, handle) {
+    static const ccl2::Topic<int(int, int)> kAdd{"/add"};
+    static const ccl2::Topic<long(int, int)> kAddLong{"/add"};
+    static const ccl2::Topic<int(int)> kAddOne{"/add"};
+
+    ccl2::Service<> svc;
+    EXPECT_THROW(svc.resolve(kAdd), std::runtime_error);
+    svc.register_handler("/add", [](int a, int b) { return a + b; });
+
+    auto add = svc.resolve(kAdd);
+    EXPECT_TRUE(add);
+    EXPECT_EQ(add(3, 4), 7);
+    EXPECT_EQ(add(short(1), 2), 3);
+    EXPECT_THROW(svc.resolve(kAddLong), std::runtime_error);
+    EXPECT_THROW(svc.resolve(kAddOne), std::runtime_error);
+
+    // still valid after other registrations
+    for (int i = 0; i < 100; i++) {
+        svc.register_handler("/n" + std::to_string(i), [i] { return i; });
+    }
+    EXPECT_EQ(add(5, 6), 11);
+
+    decltype(add) empty;
+    EXPECT_FALSE(empty);
+    EXPECT_THROW(empty(1, 2), std::runtime_error);
+}
+
+TEST(Service, rcu) {
+    ccl2::Service<ccl2::RcuMutex, std::shared_lock> svc;
+    svc.register_handler("/add", [](int a, int b) { return a + b; });
+
+    // callers never wait for the writer
+    std::atomic<bool> stop{false};
+    std::atomic<int> calls{0};
+    std::vector<std::thread> callers;
+    for (int i = 0; i < 4; i++) {
+        callers.emplace_back([&] {
+            while (!stop.load()) {
+                EXPECT_EQ(svc.call<int>("/add", 1, 2), 3);
+                calls++;
+            }
+        });
+    }
+    for (int i = 0; i < 200 || calls.load() == 0; i++) {
+        svc.register_handler("/n" + std::to_string(i), [i] { return i; });
+    }
+    stop = true;
+    for (auto& th : callers) {
+        th.join();
+    }
+    EXPECT_EQ(svc.call<int>("/n42"), 42);
+}
+
+TEST(Service, async_call) {
+    // the pool is joined first
+    boost::asio::io_context ioc;
+    boost::asio::thread_pool pool(1);
+    ccl2::Service<std::shared_mutex, std::shared_lock> svc;
+    std::thread::id handler_thread;
+    svc.register_handler("/add", [&](int a, int b) {
+        handler_thread = std::this_thread::get_id();
+        return a + b;
+    });
+
+    // the handler runs on the pool, the callback on its associated executor
+    int r = 0;
+    svc.async_call<int>(pool.get_executor(), "/add", 3, 4,
+                        boost::asio::bind_executor(
+                            ioc, [&](std::exception_ptr e, std::optional<int> v) {
+                                EXPECT_FALSE(e);
+                                r = v.value();
+                            }));
+    // waits for the completion
+    ioc.run();
+    EXPECT_EQ(r, 7);
+    EXPECT_NE(handler_thread, std::this_thread::get_id());
+
+    // the errors of call() go to the completion
+    std::exception_ptr err;
+    std::optional<int> none = 0;
+    svc.async_call<int>(ioc.get_executor(), "/sub", 3, 4,
+                        [&](std::exception_ptr e, std::optional<int> v) {
+                            err  = e;
+                            none = v;
+                        });
+    ioc.restart();
+    ioc.run();
+    EXPECT_THROW(std::rethrow_exception(err), std::runtime_error);
+    EXPECT_FALSE(none);
+}
+
+TEST(Service, async_call_no_default) {
+    struct Port {
+        explicit Port(int v) : v(v) {}
+        int v;
+    };
+    static const ccl2::Topic<Port(int)> kPort{"/port"};
+    static const ccl2::Topic<boost::asio::awaitable<Port>(int)> kSlowPort{"/slow_port"};
+
+    boost::asio::io_context ioc;
+    ccl2::Service<> svc;
+    svc.register_handler(kPort, [](int v) {
+        if (v < 0) {
+            throw std::runtime_error("negative");
+        }
+        return Port(v);
+    });
+    svc.register_handler(kSlowPort, [](int v) -> boost::asio::awaitable<Port> {
+        if (v < 0) {
+            throw std::runtime_error("negative");
+        }
+        co_return Port(v);
+    });
+
+    std::vector<int> ports;
+    int errors = 0;
+    auto on_port = [&](std::exception_ptr e, std::optional<Port> p) {
+        if (e) {
+            EXPECT_FALSE(p);
+            errors++;
+        } else {
+            ports.push_back(p.value().v);
+        }
+    };
+    svc.async_call(ioc.get_executor(), kPort, 80, on_port);
+    svc.async_call(ioc.get_executor(), kPort, -1, on_port);
+    svc.async_call(ioc.get_executor(), kSlowPort, 443, on_port);
+    svc.async_call(ioc.get_executor(), kSlowPort, -1, on_port);
+    ioc.run();
+    EXPECT_EQ(ports, (std::vector<int>{80, 443}));
+    EXPECT_EQ(errors, 2);
+}
+
+TEST(Service, async_call_awaitable) {
+    static const ccl2::Topic<boost::asio::awaitable<int>(int)> kSlow{"/slow"};
+
+    boost::asio::io_context ioc;
+    ccl2::Service<> svc;
+    svc.register_handler(kSlow, [](int v) -> boost::asio::awaitable<int> {
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor,
+                                        std::chrono::milliseconds(1));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_return v * 2;
+    });
+    svc.register_handler("/fail", []() -> boost::asio::awaitable<void> {
+        throw std::runtime_error("fail");
+        co_return;
+    });
+    svc.register_handler("/name", [] { return std::string("ccl2"); });
+
+    int r = 0;
+    std::string name;
+    bool failed = false;
+    boost::asio::co_spawn(
+        ioc,
+        [&]() -> boost::asio::awaitable<void> {
+            auto ex = co_await boost::asio::this_coro::executor;
+            auto a = co_await svc.async_call(ex, kSlow, 21, boost::asio::use_awaitable);
+            auto b = co_await svc.async_call<int>(ex, "/slow", 1,
+                                                  boost::asio::use_awaitable);
+            r      = *a + *b;
+            auto n = co_await svc.async_call<std::string>(ex, "/name",
+                                                          boost::asio::use_awaitable);
+            name   = *n;
+            try {
+                co_await svc.async_call<void>(ex, "/fail", boost::asio::use_awaitable);
+            } catch (const std::runtime_error&) {
+                failed = true;
+            }
+        },
+        [](std::exception_ptr e) { EXPECT_FALSE(e); });
+    ioc.run();
+    EXPECT_EQ(r, 44);
+    EXPECT_EQ(name, "ccl2");
+    EXPECT_TRUE(failed);
+}
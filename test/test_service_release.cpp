@@ -0,0 +1,53 @@
+// the signature checks of typed calls do not depend on NDEBUG
+#ifndef NDEBUG
+#    define NDEBUG
+#endif
+
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <ccl2/service.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+// local to this translation unit, so are the instantiations taking it
+struct Probe {
+    int v;
+};
+
+}  // namespace
+
+TEST(ServiceRelease, call) {
+    static const ccl2::Topic<int(Probe)> kLen{"/len"};
+
+    ccl2::Service<> svc;
+    svc.register_handler("/len", [](const std::string& s) { return int(s.size()); });
+    EXPECT_THROW(svc.call(kLen, Probe{1}), std::runtime_error);
+    EXPECT_EQ(svc.call<int>("/len", std::string("ccl2")), 4);
+}
+
+TEST(ServiceRelease, async_call) {
+    static const ccl2::Topic<int(Probe)> kLen{"/len"};
+    static const ccl2::Topic<boost::asio::awaitable<int>(Probe)> kSlowLen{"/slow_len"};
+
+    boost::asio::io_context ioc;
+    ccl2::Service<> svc;
+    svc.register_handler("/len", [](const std::string& s) { return int(s.size()); });
+    svc.register_handler("/slow_len",
+                         [](std::string s) -> boost::asio::awaitable<int> {
+                             co_return int(s.size());
+                         });
+
+    int errors = 0;
+    auto on_len = [&](std::exception_ptr e, std::optional<int> r) {
+        EXPECT_THROW(std::rethrow_exception(e), std::runtime_error);
+        EXPECT_FALSE(r);
+        errors++;
+    };
+    svc.async_call(ioc.get_executor(), kLen, Probe{1}, on_len);
+    svc.async_call(ioc.get_executor(), kSlowLen, Probe{1}, on_len);
+    ioc.run();
+    EXPECT_EQ(errors, 2);
+}
@@ -0,0 +1,317 @@
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/signal.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Counter {
+    int on_add(int a, int b) { return n += a + b; }
+    int n = 0;
+};
+
+}  // namespace
+
+TEST(Signal, emit) {
+    ccl2::Signal<> sig;
+    int sum = 0;
+    sig.register_handler("add", [&](int a, int b) { sum += a + b; });
+    sig.register_handler("add", [&](int a, int) { return sum += a; });
+    auto counter = std::make_shared<Counter>();
+    sig.register_handler("add", &Counter::on_add, counter);
+    sig.emit("add", 1, 2);
+    EXPECT_EQ(sum, 4);
+    EXPECT_EQ(counter->n, 3);
+
+    // a view which is not null-terminated
+    std::string_view topic("addition", 3);
+    sig.emit(topic, 1, 2);
+    EXPECT_EQ(sum, 8);
+
+    sig.remove("add");
+    sig.emit("add", 1, 2);
+    EXPECT_EQ(sum, 8);
+}
+
+TEST(Signal, checked) {
+    ccl2::Signal<> sig;
+    sig.register_handler("pos", [](std::vector<int>) {});
+    EXPECT_THROW(sig.emit("pos", 1, 2), std::runtime_error);
+    EXPECT_THROW(sig.register_handler("pos", [](int) {}), std::runtime_error);
+    EXPECT_NO_THROW(sig.emit("pos", std::vector<int>{1, 2, 3}));
+}
+
+TEST(Signal, rvalue_reference) {
+    static const ccl2::Topic<void(std::string&&)> kMsg{"msg"};
+
+    // every handler sees the value, none of them moves it out from the next
+    ccl2::Signal<> sig;
+    std::vector<std::string> seen;
+    for (int i = 0; i < 3; i++) {
+        sig.register_handler(kMsg,
+                             [&](std::string&& s) { seen.push_back(std::move(s)); });
+    }
+    std::string msg = "hello";
+    sig.emit(kMsg, msg);
+    sig.emit("msg", msg);
+    EXPECT_EQ(msg, "hello");
+    EXPECT_EQ(seen, (std::vector<std::string>(6, "hello")));
+
+    // a const argument never binds to a non-const reference
+    sig.register_handler("inc", [](int& v) { v++; });
+    const int c = 1;
+    EXPECT_THROW(sig.emit("inc", c), std::runtime_error);
+}
+
+TEST(Signal, topic) {
+    static const ccl2::Topic<void(int, const std::string&)> kLog{"log"};
+
+    ccl2::Signal<> sig;
+    std::string last;
+    sig.register_handler(kLog, [&](int level, const std::string& msg) {
+        last = std::to_string(level) + msg;
+    });
+
+    // converted at compile time
+    sig.emit(kLog, 1, "hello");
+    EXPECT_EQ(last, "1hello");
+    short level = 2;
+    sig.emit(kLog, level, std::string("world"));
+    EXPECT_EQ(last, "2world");
+
+    // the string topic reaches the same handlers
+    sig.emit("log", 3, std::string("!"));
+    EXPECT_EQ(last, "3!");
+}
+
+TEST(Signal, handle) {
+    static const ccl2::Topic<void(int)> kTick{"tick"};
+
+    ccl2::Signal<> sig;
+    // resolved before any handler
+    auto h  = sig.resolve("tick");
+    auto th = sig.resolve(kTick);
+    EXPECT_EQ(h.index, th.index);
+    EXPECT_NE(sig.resolve("other").index, h.index);
+
+    int n = 0;
+    sig.register_handler(kTick, [&](int v) { n += v; });
+    sig.emit(h, 1);
+    sig.emit(th, 2);
+    EXPECT_EQ(n, 3);
+    EXPECT_THROW(sig.emit(h, 1.0), std::runtime_error);
+
+    sig.remove("tick");
+    sig.emit(th, 4);
+    EXPECT_EQ(n, 3);
+    sig.register_handler("tick", [&](int v) { n -= v; });
+    sig.emit(th, 3);
+    EXPECT_EQ(n, 0);
+
+    EXPECT_THROW(sig.emit(decltype(h){}, 1), std::runtime_error);
+}
+
+TEST(Signal, topic_slot) {
+    static const ccl2::Topic<void(int)> kTick{"tick"};
+
+    // interned on the first emit, on each signal
+    ccl2::Signal<> a, b;
+    a.resolve("other");
+    int na = 0, nb = 0;
+    a.register_handler(kTick, [&](int v) { na += v; });
+    b.register_handler(kTick, [&](int v) { nb += v; });
+    a.emit(kTick, 1);
+    EXPECT_EQ(a.resolve("tick").index, 1);
+    a.emit(kTick, 2);
+    b.emit(kTick, 3);
+    EXPECT_EQ(b.resolve("tick").index, 0);
+    a.emit(kTick, 4);
+    EXPECT_EQ(na, 7);
+    EXPECT_EQ(nb, 3);
+
+    // a copy keeps the slot
+    auto tick = kTick;
+    a.emit(tick, 1);
+    EXPECT_EQ(na, 8);
+    EXPECT_EQ(tick.slot().value.load(), kTick.slot().value.load());
+}
+
+TEST(Signal, typed_check) {
+    static const ccl2::Topic<void(int)> kTick{"tick"};
+
+    // registered by name with another signature
+    ccl2::Signal<> sig;
+    sig.register_handler("tick", [](std::string) {});
+    EXPECT_THROW(sig.resolve(kTick), std::runtime_error);
+    EXPECT_THROW(sig.emit(kTick, 1), std::runtime_error);
+
+    // resolved first
+    auto th = sig.resolve(ccl2::Topic<void(int)>{"tock"});
+    sig.register_handler("tock", [](std::string) {});
+    EXPECT_THROW(sig.emit(th, 1), std::runtime_error);
+    sig.remove("tock");
+    sig.emit(th, 1);
+}
+
+TEST(Signal, overlapping_patterns) {
+    // checked when a topic matched by both is interned
+    ccl2::Signal<> sig;
+    int n = 0;
+    sig.register_handler("/a/*", [&](int v) { n += v; });
+    sig.register_handler("/*/b", [](std::string) {});
+    EXPECT_THROW(sig.emit("/a/b", 1), std::runtime_error);
+    EXPECT_THROW(sig.resolve("/a/b"), std::runtime_error);
+    EXPECT_THROW(sig.resolve(ccl2::Topic<void(int)>{"/a/b"}), std::runtime_error);
+    EXPECT_EQ(n, 0);
+
+    // the other topics are not affected
+    sig.emit("/a/c", 1);
+    sig.emit("/c/b", std::string("x"));
+    EXPECT_EQ(n, 1);
+    sig.remove("/*/b");
+    sig.emit("/a/b", 2);
+    EXPECT_EQ(n, 3);
+}
+
+TEST(Signal, subscription) {
+    ccl2::Signal<> sig;
+    std::string order;
+    auto a = sig.register_handler("/x/y", [&](int) { order += 'a'; });
+    auto b = sig.register_handler("/x/*", [&](int) { order += 'b'; });
+    sig.register_handler("/x/y", [&](int) { order += 'c'; });
+    sig.emit("/x/y", 1);
+    EXPECT_EQ(order, "abc");
+    EXPECT_EQ(sig.handler_count("/x/y"), 3u);
+
+    sig.remove(a);
+    sig.remove(b);
+    sig.remove(b);
+    order.clear();
+    sig.emit("/x/y", 1);
+    EXPECT_EQ(order, "c");
+    EXPECT_EQ(sig.handler_count("/x/y"), 1u);
+    EXPECT_EQ(sig.handler_count("/x/z"), 0u);
+}
+
+TEST(Signal, wildcard) {
+    EXPECT_TRUE(ccl2::detail::topic_match("/a/*/c", "/a/b/c"));
+    EXPECT_FALSE(ccl2::detail::topic_match("/a/*", "/a/b/c"));
+    EXPECT_TRUE(ccl2::detail::topic_match("/a/#", "/a"));
+    EXPECT_TRUE(ccl2::detail::topic_match("#", "/a/b"));
+    EXPECT_THROW(ccl2::detail::is_topic_pattern("/a/#/c"), std::runtime_error);
+
+    ccl2::Signal<> sig;
+    std::vector<std::string> calls;
+    sig.register_handler("/sensor/17/temp", [&](double) { calls.push_back("exact"); });
+    sig.register_handler("/sensor/*/temp", [&](double) { calls.push_back("*"); });
+    sig.register_handler("/sensor/#", [&](double) { calls.push_back("#"); });
+
+    // in registration order
+    sig.emit("/sensor/17/temp", 1.0);
+    EXPECT_EQ(calls, (std::vector<std::string>{"exact", "*", "#"}));
+    calls.clear();
+    sig.emit("/sensor/18/temp", 1.0);
+    EXPECT_EQ(calls, (std::vector<std::string>{"*", "#"}));
+    calls.clear();
+    sig.emit("/sensor", 1.0);
+    sig.emit("/other/18/temp", 1.0);
+    EXPECT_EQ(calls, (std::vector<std::string>{"#"}));
+    calls.clear();
+
+    // the handle caches the match, until the subscriptions change
+    auto h = sig.resolve("/sensor/19/temp");
+    sig.emit(h, 1.0);
+    EXPECT_EQ(calls.size(), 2u);
+    sig.remove("/sensor/#");
+    sig.emit(h, 1.0);
+    EXPECT_EQ(calls.size(), 3u);
+    sig.register_handler("/sensor/18/#", [&](double) { calls.push_back("18"); });
+    sig.register_handler("/*/19/*", [&](double) { calls.push_back("19"); });
+    sig.emit(h, 1.0);
+    EXPECT_EQ(calls.back(), "19");
+    EXPECT_EQ(calls.size(), 5u);
+
+    // a pattern takes the arguments of the topics it matches
+    EXPECT_THROW(sig.register_handler("/sensor/*/temp", [](int) {}), std::runtime_error);
+    EXPECT_THROW(sig.register_handler("/*/17/temp", [](int) {}), std::runtime_error);
+    EXPECT_THROW(sig.emit("/sensor/20/temp", 1), std::runtime_error);
+    EXPECT_THROW(sig.resolve("/sensor/*"), std::runtime_error);
+}
+
+TEST(Signal, wildcard_not_interned) {
+    ccl2::Signal<> sig;
+    int n = 0;
+    sig.register_handler("/sensor/*", [&](int v) { n += v; });
+
+    // matched by name, the registry does not grow
+    for (int i = 0; i < 5000; i++) {
+        sig.emit("/sensor/" + std::to_string(i), 1);
+    }
+    EXPECT_EQ(n, 5000);
+    EXPECT_EQ(sig.resolve("/other").index, 0u);
+
+    // the cached matches follow the subscriptions
+    n        = 0;
+    auto sub = sig.register_handler("/sensor/#", [&](int v) { n += 10 * v; });
+    sig.emit("/sensor/1", 1);
+    EXPECT_EQ(n, 11);
+    sig.remove(sub);
+    sig.remove("/sensor/*");
+    sig.emit("/sensor/1", 1);
+    EXPECT_EQ(n, 11);
+    sig.register_handler("/sensor/*", [](std::string) {});
+    EXPECT_THROW(sig.emit("/sensor/1", 1), std::runtime_error);
+
+    // a handler removed is not kept alive by the cached matches
+    auto token = std::make_shared<int>(0);
+    sub        = sig.register_handler("/tmp/*", [token](int) {});
+    sig.emit("/tmp/1", 1);
+    EXPECT_EQ(token.use_count(), 2);
+    sig.remove(sub);
+    EXPECT_EQ(token.use_count(), 1);
+}
+
+TEST(Signal, rcu) {
+    ccl2::Signal<ccl2::RcuMutex, std::shared_lock> sig;
+    auto h = sig.resolve("tick");
+    std::atomic<int> n{0};
+    sig.register_handler("tick", [&](int v) { n += v; });
+
+    // emitters never wait for the writer
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> emitters;
+    for (int i = 0; i < 4; i++) {
+        emitters.emplace_back([&] {
+            while (!stop.load()) {
+                sig.emit(h, 1);
+                sig.emit("tick", 1);
+            }
+        });
+    }
+    for (int i = 0; i < 200 || n.load() == 0; i++) {
+        sig.register_handler("tock", [&](int) {});
+        sig.remove("tock");
+    }
+    stop = true;
+    for (auto& th : emitters) {
+        th.join();
+    }
+    EXPECT_GT(n.load(), 0);
+
+    // registering from a handler, the running emit keeps its snapshot
+    int calls = 0;
+    sig.register_handler("once", [&] {
+        calls++;
+        sig.register_handler("once", [&] { calls += 10; });
+    });
+    sig.emit("once");
+    EXPECT_EQ(calls, 1);
+    sig.remove("once");
+    sig.emit("once");
+    EXPECT_EQ(calls, 1);
+}
@@ -0,0 +1,89 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/signal_batch.h>
+#include <ccl2/stopwatch.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+const ccl2::Topic<void(int, const std::string&)> kEvent{"event"};
+
+}  // namespace
+
+TEST(BatchEmitter, batch) {
+    boost::asio::io_context ioc;
+    ccl2::Signal<> sig;
+    std::vector<int> got;
+    sig.register_handler(kEvent, [&](int i, const std::string& s) {
+        EXPECT_EQ(s, std::to_string(i));
+        got.push_back(i);
+    });
+
+    decltype(ccl2::BatchEmitter(sig, kEvent, ioc.get_executor()))::options_t options;
+    options.max_batch = 4;
+    options.max_delay = std::chrono::milliseconds(10);
+    ccl2::BatchEmitter emitter(sig, kEvent, ioc.get_executor(), options);
+    for (int i = 0; i < 10; i++) {
+        emitter.emit(i, std::to_string(i));
+    }
+    EXPECT_EQ(emitter.pending(), 10u);
+    EXPECT_TRUE(got.empty());
+
+    ioc.run();
+    ASSERT_EQ(got.size(), 10u);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(got[i], i);
+    }
+    EXPECT_EQ(emitter.batches(), 3u);
+    EXPECT_EQ(emitter.pending(), 0u);
+
+    // not full, waits for max_delay
+    emitter.emit(10, "10");
+    emitter.emit(11, "11");
+    ccl2::StopWatch sw;
+    ioc.restart();
+    ioc.run();
+    EXPECT_GE(sw.elapsed(), 0.009);
+    EXPECT_EQ(got.size(), 12u);
+    EXPECT_EQ(emitter.batches(), 4u);
+}
+
+TEST(BatchEmitter, producers) {
+    boost::asio::io_context ioc;
+    auto work = boost::asio::make_work_guard(ioc);
+    ccl2::Signal<ccl2::RcuMutex, std::shared_lock> sig;
+
+    constexpr int kProducers = 4;
+    constexpr int kEvents    = 5000;
+    std::vector<int> last(kProducers, -1);
+    std::atomic<int> total{0};
+    sig.register_handler(kEvent, [&](int i, const std::string& s) {
+        // in order per producer
+        int p = std::stoi(s);
+        EXPECT_GT(i, last[p]);
+        last[p] = i;
+        if (++total == kProducers * kEvents) {
+            work.reset();
+        }
+    });
+
+    ccl2::BatchEmitter emitter(sig, kEvent, ioc.get_executor());
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kEvents; i++) {
+                emitter.emit(i, std::to_string(p));
+            }
+        });
+    }
+    std::thread th([&] { ioc.run(); });
+    for (auto& t : producers) {
+        t.join();
+    }
+    th.join();
+    EXPECT_EQ(total.load(), kProducers * kEvents);
+    EXPECT_LT(emitter.batches(), uint64_t(kProducers * kEvents));
+}
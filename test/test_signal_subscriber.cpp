@@ -0,0 +1,177 @@
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ccl2/signal_subscriber.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+const ccl2::Topic<void(int, const std::string&)> kEvent{"/event/*"};
+
+template <class Sig>
+using Subscriber = decltype(ccl2::AsyncSubscriber(
+    std::declval<Sig&>(), kEvent, std::declval<boost::asio::any_io_executor>(),
+    [](int, const std::string&) {}));
+
+}  // namespace
+
+TEST(AsyncSubscriber, queue) {
+    boost::asio::io_context ioc;
+    ccl2::Signal<> sig;
+    std::vector<int> got;
+
+    Subscriber<ccl2::Signal<>>::options_t options;
+    options.max_batch = 4;
+    ccl2::AsyncSubscriber sub(
+        sig, kEvent, ioc.get_executor(),
+        [&](int i, const std::string& s) {
+            EXPECT_EQ(s, std::to_string(i));
+            got.push_back(i);
+        },
+        options);
+
+    // the emitter only enqueues
+    for (int i = 0; i < 10; i++) {
+        sig.emit("/event/a", i, std::to_string(i));
+    }
+    EXPECT_TRUE(got.empty());
+    EXPECT_EQ(sub.metrics().queued, 10u);
+
+    ioc.run();
+    ASSERT_EQ(got.size(), 10u);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(got[i], i);
+    }
+    auto m = sub.metrics();
+    EXPECT_EQ(m.queued, 0u);
+    EXPECT_EQ(m.delivered, 10u);
+    EXPECT_EQ(m.dropped, 0u);
+    EXPECT_GT(m.max_lag.count(), 0);
+    EXPECT_LE(m.lag, m.max_lag);
+}
+
+TEST(AsyncSubscriber, overflow) {
+    using overflow_t = Subscriber<ccl2::Signal<>>::overflow_t;
+    for (auto overflow : {overflow_t::drop_newest, overflow_t::drop_oldest}) {
+        boost::asio::io_context ioc;
+        ccl2::Signal<> sig;
+        std::vector<int> got;
+
+        Subscriber<ccl2::Signal<>>::options_t options;
+        options.capacity = 4;
+        options.overflow = overflow;
+        ccl2::AsyncSubscriber sub(
+            sig, kEvent, ioc.get_executor(),
+            [&](int i, const std::string&) { got.push_back(i); }, options);
+        for (int i = 0; i < 10; i++) {
+            sig.emit("/event/a", i, std::string());
+        }
+        EXPECT_EQ(sub.metrics().queued, 4u);
+        EXPECT_EQ(sub.metrics().dropped, 6u);
+
+        ioc.run();
+        int first = overflow == overflow_t::drop_newest ? 0 : 6;
+        EXPECT_EQ(got, (std::vector<int>{first, first + 1, first + 2, first + 3}));
+    }
+}
+
+TEST(AsyncSubscriber, producers) {
+    boost::asio::thread_pool pool(2);
+    ccl2::Signal<ccl2::RcuMutex, std::shared_lock> sig;
+
+    constexpr int kProducers = 4;
+    constexpr int kEvents    = 5000;
+    std::atomic<int> n{0};
+    std::vector<int> last(kProducers, -1);
+    bool ordered = true;
+
+    // ordered per producer, never concurrent: on a strand of the pool
+    Subscriber<decltype(sig)>::options_t options;
+    options.capacity = kProducers * kEvents;
+    ccl2::AsyncSubscriber sub(
+        sig, kEvent, pool.get_executor(),
+        [&](int i, const std::string& who) {
+            int p   = std::stoi(who);
+            ordered = ordered && i > last[p];
+            last[p] = i;
+            n++;
+        },
+        options);
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p] {
+            for (int i = 0; i < kEvents; i++) {
+                sig.emit("/event/" + std::to_string(p), i, std::to_string(p));
+            }
+        });
+    }
+    for (auto& th : producers) {
+        th.join();
+    }
+    pool.join();
+
+    EXPECT_EQ(n.load(), kProducers * kEvents);
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(sub.metrics().delivered, uint64_t(kProducers * kEvents));
+}
+
+TEST(AsyncSubscriber, close) {
+    boost::asio::io_context ioc;
+    ccl2::Signal<> sig;
+    int n = 0;
+
+    std::optional<Subscriber<ccl2::Signal<>>> sub;
+    sub.emplace(sig, kEvent, ioc.get_executor(), [&](int, const std::string&) { n++; });
+    sig.emit("/event/a", 1, std::string());
+    sub.reset();
+    sig.emit("/event/a", 2, std::string());
+    ioc.run();
+    EXPECT_EQ(n, 0);
+}
+
+TEST(AsyncSubscriber, unsubscribe) {
+    boost::asio::io_context ioc;
+    ccl2::Signal<> sig;
+    sig.register_handler("/event/a", [](int, const std::string&) {});
+    EXPECT_EQ(sig.handler_count("/event/a"), 1u);
+
+    // the handlers do not pile up in the signal
+    int n = 0;
+    for (int i = 0; i < 100; i++) {
+        Subscriber<ccl2::Signal<>> sub(sig, kEvent, ioc.get_executor(),
+                                       [&](int, const std::string&) { n++; });
+        EXPECT_EQ(sig.handler_count("/event/a"), 2u);
+        sig.emit("/event/a", i, std::string());
+    }
+    EXPECT_EQ(sig.handler_count("/event/a"), 1u);
+    EXPECT_EQ(sig.handler_count("/event/b"), 0u);
+    ioc.run();
+    EXPECT_EQ(n, 0);
+}
+
+TEST(AsyncSubscriber, in_flight) {
+    boost::asio::thread_pool pool(1);
+    ccl2::Signal<ccl2::RcuMutex, std::shared_lock> sig;
+    std::atomic<bool> started{false};
+    std::atomic<bool> done{false};
+
+    std::optional<Subscriber<ccl2::Signal<ccl2::RcuMutex, std::shared_lock>>> sub;
+    sub.emplace(sig, kEvent, pool.get_executor(), [&](int, const std::string&) {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        done = true;
+    });
+    sig.emit("/event/a", 1, std::string());
+    while (!started) {
+        std::this_thread::yield();
+    }
+    // waits for the event being delivered
+    sub.reset();
+    EXPECT_TRUE(done);
+    pool.join();
+}